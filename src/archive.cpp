@@ -0,0 +1,117 @@
+#include "archive.hpp"
+#include "decompress.hpp"
+#include "hash_win32.hpp"
+#include "pipeline.hpp"
+#include "throttle.hpp"
+
+#include <chrono>
+#include <fstream>
+
+namespace hashcore {
+
+namespace {
+
+ArchiveCompression sniff_compression(const fs::path &archive_path) {
+	unsigned char magic[4] = {};
+	std::ifstream in(archive_path, std::ios::binary);
+	if (!in.read(reinterpret_cast<char *>(magic), sizeof(magic))) {
+		return ArchiveCompression::None;
+	}
+	if (magic[0] == 0x1F && magic[1] == 0x8B) {
+		return ArchiveCompression::Gzip;
+	}
+	if (magic[0] == 0x28 && magic[1] == 0xB5 && magic[2] == 0x2F && magic[3] == 0xFD) {
+		return ArchiveCompression::Zstd;
+	}
+	return ArchiveCompression::None;
+}
+
+template <class Source>
+bool hash_tar_stream(Source &source,
+	const fs::path &archive_path,
+	std::vector<ArchiveMemberDigest> &out_members,
+	uint64_t &out_archive_bytes,
+	double &out_elapsed_seconds,
+	std::string &out_error,
+	std::atomic<bool> *cancel_flag) {
+	if (!source.open(archive_path, out_error)) {
+		return false;
+	}
+	out_archive_bytes = source.size();
+
+	TarStreamHasher<CngSha256> tar;
+	if (!tar.init(out_error)) {
+		return false;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	ChunkPipeline<Source> pipeline(source);
+	pipeline.start();
+	while (!tar.done()) {
+		const unsigned char *data = nullptr;
+		size_t length = 0;
+		if (!pipeline.next(data, length, out_error)) {
+			return false;
+		}
+		if (length == 0) {
+			break;
+		}
+		if (!tar.feed(data, length, out_error)) {
+			return false;
+		}
+		if (cancel_flag && cancel_flag->load(std::memory_order_relaxed)) {
+			out_error = "Cancelled";
+			return false;
+		}
+	}
+	pipeline.stop();
+	if (!tar.finish(out_error)) {
+		return false;
+	}
+	auto end = std::chrono::steady_clock::now();
+	out_elapsed_seconds = std::chrono::duration<double>(end - start).count();
+	out_members = std::move(tar.members());
+	return true;
+}
+
+}
+
+bool hash_tar_members(const fs::path &archive_path,
+	ArchiveCompression compression,
+	std::vector<ArchiveMemberDigest> &out_members,
+	uint64_t &out_archive_bytes,
+	double &out_elapsed_seconds,
+	std::string &out_error,
+	Throttle *throttle,
+	std::atomic<bool> *cancel_flag) {
+	if (compression == ArchiveCompression::Auto) {
+		compression = sniff_compression(archive_path);
+	}
+
+	switch (compression) {
+	case ArchiveCompression::Gzip: {
+#if defined(HASHCORE_HAS_ZLIB)
+		GzipSource<ThrottledSource<Win32FileSource>> source(throttle);
+		return hash_tar_stream(source, archive_path, out_members, out_archive_bytes, out_elapsed_seconds, out_error, cancel_flag);
+#else
+		out_error = "gzip support not built (configure with -DWITH_ZLIB=ON)";
+		return false;
+#endif
+	}
+	case ArchiveCompression::Zstd: {
+#if defined(HASHCORE_HAS_ZSTD)
+		ZstdSource<ThrottledSource<Win32FileSource>> source(throttle);
+		return hash_tar_stream(source, archive_path, out_members, out_archive_bytes, out_elapsed_seconds, out_error, cancel_flag);
+#else
+		out_error = "zstd support not built (configure with -DWITH_ZSTD=ON)";
+		return false;
+#endif
+	}
+	default: {
+		ThrottledSource<Win32FileSource> source(throttle);
+		return hash_tar_stream(source, archive_path, out_members, out_archive_bytes, out_elapsed_seconds, out_error, cancel_flag);
+	}
+	}
+}
+
+}
@@ -0,0 +1,39 @@
+// archive.hpp - hash tar archive members in a single streaming pass (no extraction)
+#pragma once
+
+#include "hash.hpp"
+#include "tar_stream.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace hashcore {
+
+class Throttle;
+
+using ArchiveMemberDigest = TarMember<Sha256Digest>;
+
+enum class ArchiveCompression {
+	Auto,  // sniff gzip/zstd magic bytes, otherwise plain tar
+	None,
+	Gzip,  // requires WITH_ZLIB
+	Zstd   // requires WITH_ZSTD
+};
+
+// Read a tar (optionally gzip/zstd compressed) archive exactly once and compute the SHA-256
+// of every regular member's data. Reading and decompression run on a separate thread from
+// parsing and hashing. Nothing is written to disk.
+// - out_archive_bytes: on-disk (compressed) archive size
+// - throttle, cancel_flag: optional, same semantics as compute_sha256_streamed_throttled
+bool hash_tar_members(const fs::path &archive_path,
+	ArchiveCompression compression,
+	std::vector<ArchiveMemberDigest> &out_members,
+	uint64_t &out_archive_bytes,
+	double &out_elapsed_seconds,
+	std::string &out_error,
+	Throttle *throttle = nullptr,
+	std::atomic<bool> *cancel_flag = nullptr);
+
+}
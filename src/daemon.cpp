@@ -0,0 +1,369 @@
+#include "daemon.hpp"
+#include "throttle.hpp"
+
+#include <winsock2.h>
+#include <afunix.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+#if defined(_MSC_VER)
+#pragma comment(lib, "Ws2_32.lib")
+#endif
+
+#ifndef IO_REPARSE_TAG_AF_UNIX
+#define IO_REPARSE_TAG_AF_UNIX 0x80000023L
+#endif
+
+namespace hashcore {
+
+namespace {
+
+bool start_winsock(std::string &out_error) {
+	WSADATA data{};
+	if (WSAStartup(MAKEWORD(2, 2), &data) != 0) {
+		out_error = "WSAStartup failed";
+		return false;
+	}
+	return true;
+}
+
+bool make_address(const fs::path &socket_path, sockaddr_un &out_address, std::string &out_error) {
+	std::string utf8 = socket_path.u8string();
+	if (utf8.empty() || utf8.size() >= sizeof(out_address.sun_path)) {
+		out_error = "Socket path is empty or too long";
+		return false;
+	}
+	std::memset(&out_address, 0, sizeof(out_address));
+	out_address.sun_family = AF_UNIX;
+	std::memcpy(out_address.sun_path, utf8.data(), utf8.size());
+	return true;
+}
+
+// A socket file left behind by a previous run would make bind fail, so remove it, but
+// only if it really is an AF_UNIX socket: a mistyped --socket must not delete a file.
+bool remove_stale_socket(const fs::path &socket_path, std::string &out_error) {
+	WIN32_FIND_DATAW data{};
+	HANDLE find = FindFirstFileW(socket_path.wstring().c_str(), &data);
+	if (find == INVALID_HANDLE_VALUE) {
+		DWORD error = GetLastError();
+		if (error == ERROR_FILE_NOT_FOUND || error == ERROR_PATH_NOT_FOUND) {
+			return true;
+		}
+		out_error = "Cannot inspect socket path";
+		return false;
+	}
+	FindClose(find);
+	bool is_socket = (data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) && data.dwReserved0 == IO_REPARSE_TAG_AF_UNIX;
+	if (!is_socket) {
+		out_error = "Socket path exists and is not a socket: " + socket_path.u8string();
+		return false;
+	}
+	if (!DeleteFileW(socket_path.wstring().c_str())) {
+		out_error = "Failed to remove stale socket: " + socket_path.u8string();
+		return false;
+	}
+	return true;
+}
+
+bool send_all(SOCKET socket, const std::vector<unsigned char> &bytes) {
+	size_t sent = 0;
+	while (sent < bytes.size()) {
+		int chunk = static_cast<int>(std::min<size_t>(bytes.size() - sent, 1 << 20));
+		int rc = send(socket, reinterpret_cast<const char *>(bytes.data() + sent), chunk, 0);
+		if (rc <= 0) {
+			return false;
+		}
+		sent += static_cast<size_t>(rc);
+	}
+	return true;
+}
+
+bool recv_all(SOCKET socket, unsigned char *data, size_t length) {
+	size_t received = 0;
+	while (received < length) {
+		int chunk = static_cast<int>(std::min<size_t>(length - received, 1 << 20));
+		int rc = recv(socket, reinterpret_cast<char *>(data + received), chunk, 0);
+		if (rc <= 0) {
+			return false;
+		}
+		received += static_cast<size_t>(rc);
+	}
+	return true;
+}
+
+// Read one complete frame (header + payload).
+bool recv_frame(SOCKET socket, FrameHeader &out_header, std::vector<unsigned char> &out_payload, std::string &out_error) {
+	unsigned char header[kFrameHeaderSize];
+	if (!recv_all(socket, header, sizeof(header))) {
+		out_error = "Connection closed";
+		return false;
+	}
+	if (!decode_frame_header(header, out_header, out_error)) {
+		return false;
+	}
+	out_payload.resize(out_header.payload_length);
+	if (!out_payload.empty() && !recv_all(socket, out_payload.data(), out_payload.size())) {
+		out_error = "Connection closed";
+		return false;
+	}
+	return true;
+}
+
+ResultRecord to_record(const FileHashResult &result, bool coalesced) {
+	ResultRecord record;
+	record.status = result.success ? ResultStatus::Ok : ResultStatus::Error;
+	record.flags = static_cast<uint8_t>((result.from_cache ? kResultFromCache : 0) | (coalesced ? kResultCoalesced : 0));
+	record.size_bytes = result.size_bytes;
+	record.digest = result.digest;
+	record.message = result.error;
+	return record;
+}
+
+struct DaemonState {
+	std::atomic<SOCKET> listener{INVALID_SOCKET};
+	std::atomic<bool> stopping{false};
+	std::mutex mutex;
+	std::condition_variable idle_cv;
+	std::set<SOCKET> clients;
+	size_t active_connections = 0;
+
+	void close_listener() {
+		SOCKET socket = listener.exchange(INVALID_SOCKET);
+		if (socket != INVALID_SOCKET) {
+			closesocket(socket);
+		}
+	}
+};
+
+Response handle_request(const Request &request, HashService &service, Throttle *throttle) {
+	Response response;
+	response.opcode = request.opcode;
+
+	switch (request.opcode) {
+	case Opcode::Hash:
+	case Opcode::Verify: {
+		bool coalesced = false;
+		FileHashResult result = service.submit(fs::u8path(request.paths.front()), &coalesced).get();
+		ResultRecord record = to_record(result, coalesced);
+		if (request.opcode == Opcode::Verify && result.success && result.digest.bytes != request.expected.bytes) {
+			record.status = ResultStatus::Mismatch;
+		}
+		response.results.push_back(std::move(record));
+		break;
+	}
+	case Opcode::Batch: {
+		// Submit everything first so the worker pool sees the whole batch at once.
+		std::vector<std::shared_future<FileHashResult>> pending;
+		std::vector<bool> coalesced(request.paths.size(), false);
+		pending.reserve(request.paths.size());
+		for (size_t i = 0; i < request.paths.size(); ++i) {
+			bool joined = false;
+			pending.push_back(service.submit(fs::u8path(request.paths[i]), &joined));
+			coalesced[i] = joined;
+		}
+		for (size_t i = 0; i < pending.size(); ++i) {
+			response.results.push_back(to_record(pending[i].get(), coalesced[i]));
+		}
+		break;
+	}
+	case Opcode::Shutdown:
+		break;
+	case Opcode::SetThrottle: {
+		ResultRecord record;
+		if (throttle) {
+			throttle->set_bytes_per_second(request.bytes_per_second);
+			throttle->set_max_iops(request.max_iops);
+			throttle->set_background(request.background);
+		} else {
+			record.status = ResultStatus::Error;
+			record.message = "Daemon was started without a throttle";
+		}
+		response.results.push_back(std::move(record));
+		break;
+	}
+	}
+	return response;
+}
+
+void serve_connection(SOCKET client, HashService &service, Throttle *throttle, DaemonState &state) {
+	for (;;) {
+		FrameHeader header;
+		std::vector<unsigned char> payload;
+		std::string error;
+		if (!recv_frame(client, header, payload, error)) {
+			break;
+		}
+		Request request;
+		if (!decode_request(header.opcode, payload, request, error)) {
+			break;
+		}
+		Response response = handle_request(request, service, throttle);
+		if (!send_all(client, encode_response(response))) {
+			break;
+		}
+		if (request.opcode == Opcode::Shutdown) {
+			state.stopping.store(true);
+			state.close_listener();
+			break;
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(state.mutex);
+	state.clients.erase(client);
+	closesocket(client);
+	--state.active_connections;
+	state.idle_cv.notify_all();
+}
+
+}
+
+fs::path default_socket_path() {
+	std::error_code ec;
+	fs::path temp = fs::temp_directory_path(ec);
+	return (ec ? fs::path(".") : temp) / "c-hash.sock";
+}
+
+bool run_daemon(const DaemonOptions &options, std::string &out_error) {
+	fs::path socket_path = options.socket_path.empty() ? default_socket_path() : options.socket_path;
+	sockaddr_un address{};
+	if (!make_address(socket_path, address, out_error)) {
+		return false;
+	}
+	if (!remove_stale_socket(socket_path, out_error)) {
+		return false;
+	}
+	if (!start_winsock(out_error)) {
+		return false;
+	}
+
+	SOCKET listener = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listener == INVALID_SOCKET) {
+		WSACleanup();
+		out_error = "socket(AF_UNIX) failed";
+		return false;
+	}
+	if (bind(listener, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) == SOCKET_ERROR || listen(listener, SOMAXCONN) == SOCKET_ERROR) {
+		closesocket(listener);
+		WSACleanup();
+		out_error = "Failed to bind daemon socket";
+		return false;
+	}
+
+	HashService service(options.service);
+	Throttle *throttle = options.service.throttle;
+	DaemonState state;
+	state.listener.store(listener);
+
+	bool ok = true;
+	while (!state.stopping.load()) {
+		SOCKET current = state.listener.load();
+		if (current == INVALID_SOCKET) {
+			break;
+		}
+		SOCKET client = accept(current, nullptr, nullptr);
+		if (client == INVALID_SOCKET) {
+			if (state.stopping.load()) {
+				break;  // Shutdown closed the listener under us
+			}
+			int error = WSAGetLastError();
+			if (error == WSAECONNRESET || error == WSAEINTR) {
+				continue;  // peer vanished before accept completed
+			}
+			if (error == WSAEMFILE || error == WSAENOBUFS) {
+				// Out of sockets or buffers: give existing connections a moment to finish.
+				std::this_thread::sleep_for(std::chrono::milliseconds(100));
+				continue;
+			}
+			out_error = "accept failed (WSA error " + std::to_string(error) + ")";
+			ok = false;
+			break;
+		}
+		{
+			std::lock_guard<std::mutex> lock(state.mutex);
+			state.clients.insert(client);
+			++state.active_connections;
+		}
+		std::thread([client, &service, throttle, &state]() { serve_connection(client, service, throttle, state); }).detach();
+	}
+
+	state.close_listener();
+	{
+		// Wake connections blocked in recv so they can exit before the service goes away.
+		std::unique_lock<std::mutex> lock(state.mutex);
+		for (SOCKET client : state.clients) {
+			shutdown(client, SD_BOTH);
+		}
+		state.idle_cv.wait(lock, [&state]() { return state.active_connections == 0; });
+	}
+	std::error_code ec;
+	fs::remove(socket_path, ec);
+	WSACleanup();
+	return ok;
+}
+
+DaemonClient::DaemonClient() : socket_(static_cast<uintptr_t>(INVALID_SOCKET)) {}
+
+DaemonClient::~DaemonClient() {
+	if (static_cast<SOCKET>(socket_) != INVALID_SOCKET) {
+		closesocket(static_cast<SOCKET>(socket_));
+	}
+	if (winsock_started_) {
+		WSACleanup();
+	}
+}
+
+bool DaemonClient::connect(const fs::path &socket_path, std::string &out_error) {
+	sockaddr_un address{};
+	if (!make_address(socket_path.empty() ? default_socket_path() : socket_path, address, out_error)) {
+		return false;
+	}
+	if (!winsock_started_) {
+		if (!start_winsock(out_error)) {
+			return false;
+		}
+		winsock_started_ = true;
+	}
+	SOCKET socket_handle = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (socket_handle == INVALID_SOCKET) {
+		out_error = "socket(AF_UNIX) failed";
+		return false;
+	}
+	if (::connect(socket_handle, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) == SOCKET_ERROR) {
+		closesocket(socket_handle);
+		out_error = "Failed to connect to daemon (is it running?)";
+		return false;
+	}
+	socket_ = static_cast<uintptr_t>(socket_handle);
+	return true;
+}
+
+bool DaemonClient::call(const Request &request, Response &out_response, std::string &out_error) {
+	SOCKET socket_handle = static_cast<SOCKET>(socket_);
+	if (socket_handle == INVALID_SOCKET) {
+		out_error = "Not connected";
+		return false;
+	}
+	if (!send_all(socket_handle, encode_request(request))) {
+		out_error = "Failed to send request";
+		return false;
+	}
+	FrameHeader header;
+	std::vector<unsigned char> payload;
+	if (!recv_frame(socket_handle, header, payload, out_error)) {
+		return false;
+	}
+	if (header.opcode != request.opcode) {
+		out_error = "Unexpected response opcode";
+		return false;
+	}
+	return decode_response(header.opcode, payload, out_response, out_error);
+}
+
+}
@@ -0,0 +1,44 @@
+// daemon.hpp - long-running hashing daemon and thin client over a Unix domain socket
+#pragma once
+
+#include "daemon_protocol.hpp"
+#include "hash.hpp"
+#include "hash_service.hpp"
+
+#include <cstdint>
+#include <string>
+
+namespace hashcore {
+
+struct DaemonOptions {
+	fs::path socket_path;     // empty = default_socket_path()
+	ServiceOptions service;
+};
+
+// %TEMP%\c-hash.sock
+fs::path default_socket_path();
+
+// Serve Hash/Verify/Batch requests on an AF_UNIX socket until a Shutdown request arrives.
+// All connections share one HashService (worker pool, buffer pool, digest cache).
+// A stale socket left at socket_path is replaced; any other file there is an error.
+// Returns false if the socket could not be created or bound, or if accept fails with
+// anything other than a transient error (those are retried).
+bool run_daemon(const DaemonOptions &options, std::string &out_error);
+
+// Blocking client for one daemon connection; requests are answered in order.
+class DaemonClient {
+public:
+	DaemonClient();
+	DaemonClient(const DaemonClient &) = delete;
+	DaemonClient &operator=(const DaemonClient &) = delete;
+	~DaemonClient();
+
+	bool connect(const fs::path &socket_path, std::string &out_error);
+	bool call(const Request &request, Response &out_response, std::string &out_error);
+
+private:
+	uintptr_t socket_;
+	bool winsock_started_ = false;
+};
+
+}
@@ -0,0 +1,229 @@
+#include "daemon_protocol.hpp"
+
+#include <cstring>
+
+namespace hashcore {
+
+namespace {
+
+class Writer {
+public:
+	void u8(uint8_t value) { bytes_.push_back(value); }
+	void u16(uint16_t value) {
+		for (int i = 0; i < 2; ++i) bytes_.push_back(static_cast<unsigned char>(value >> (8 * i)));
+	}
+	void u32(uint32_t value) {
+		for (int i = 0; i < 4; ++i) bytes_.push_back(static_cast<unsigned char>(value >> (8 * i)));
+	}
+	void u64(uint64_t value) {
+		for (int i = 0; i < 8; ++i) bytes_.push_back(static_cast<unsigned char>(value >> (8 * i)));
+	}
+	void digest(const Sha256Digest &value) { bytes_.insert(bytes_.end(), value.bytes.begin(), value.bytes.end()); }
+	void string(const std::string &value) {
+		u32(static_cast<uint32_t>(value.size()));
+		bytes_.insert(bytes_.end(), value.begin(), value.end());
+	}
+
+	// Prefix the accumulated payload with a frame header.
+	std::vector<unsigned char> frame(Opcode opcode) {
+		Writer header;
+		header.u32(kProtocolMagic);
+		header.u8(kProtocolVersion);
+		header.u8(static_cast<uint8_t>(opcode));
+		header.u16(0);
+		header.u32(static_cast<uint32_t>(bytes_.size()));
+		header.bytes_.insert(header.bytes_.end(), bytes_.begin(), bytes_.end());
+		return std::move(header.bytes_);
+	}
+
+private:
+	std::vector<unsigned char> bytes_;
+};
+
+class Reader {
+public:
+	Reader(const unsigned char *data, size_t size) : data_(data), size_(size) {}
+
+	bool u8(uint8_t &out) {
+		if (!has(1)) return false;
+		out = data_[pos_++];
+		return true;
+	}
+	bool u16(uint16_t &out) {
+		uint64_t value = 0;
+		if (!little_endian(2, value)) return false;
+		out = static_cast<uint16_t>(value);
+		return true;
+	}
+	bool u32(uint32_t &out) {
+		uint64_t value = 0;
+		if (!little_endian(4, value)) return false;
+		out = static_cast<uint32_t>(value);
+		return true;
+	}
+	bool u64(uint64_t &out) { return little_endian(8, out); }
+	bool digest(Sha256Digest &out) {
+		if (!has(out.bytes.size())) return false;
+		std::memcpy(out.bytes.data(), data_ + pos_, out.bytes.size());
+		pos_ += out.bytes.size();
+		return true;
+	}
+	bool string(std::string &out) {
+		uint32_t length = 0;
+		if (!u32(length) || !has(length)) return false;
+		out.assign(reinterpret_cast<const char *>(data_ + pos_), length);
+		pos_ += length;
+		return true;
+	}
+	bool at_end() const { return pos_ == size_; }
+
+private:
+	bool has(size_t count) const { return size_ - pos_ >= count; }
+	bool little_endian(int width, uint64_t &out) {
+		if (!has(static_cast<size_t>(width))) return false;
+		out = 0;
+		for (int i = 0; i < width; ++i) {
+			out |= static_cast<uint64_t>(data_[pos_ + i]) << (8 * i);
+		}
+		pos_ += static_cast<size_t>(width);
+		return true;
+	}
+
+	const unsigned char *data_;
+	size_t size_;
+	size_t pos_ = 0;
+};
+
+}
+
+std::vector<unsigned char> encode_request(const Request &request) {
+	Writer writer;
+	switch (request.opcode) {
+	case Opcode::Hash:
+		writer.string(request.paths.empty() ? std::string() : request.paths.front());
+		break;
+	case Opcode::Verify:
+		writer.digest(request.expected);
+		writer.string(request.paths.empty() ? std::string() : request.paths.front());
+		break;
+	case Opcode::Batch:
+		writer.u32(static_cast<uint32_t>(request.paths.size()));
+		for (const auto &path : request.paths) {
+			writer.string(path);
+		}
+		break;
+	case Opcode::Shutdown:
+		break;
+	case Opcode::SetThrottle:
+		writer.u64(request.bytes_per_second);
+		writer.u32(request.max_iops);
+		writer.u8(request.background ? 1 : 0);
+		break;
+	}
+	return writer.frame(request.opcode);
+}
+
+std::vector<unsigned char> encode_response(const Response &response) {
+	Writer writer;
+	writer.u32(static_cast<uint32_t>(response.results.size()));
+	for (const auto &result : response.results) {
+		writer.u8(static_cast<uint8_t>(result.status));
+		writer.u8(result.flags);
+		writer.u64(result.size_bytes);
+		writer.digest(result.digest);
+		writer.string(result.message);
+	}
+	return writer.frame(response.opcode);
+}
+
+bool decode_frame_header(const unsigned char *data, FrameHeader &out_header, std::string &out_error) {
+	Reader reader(data, kFrameHeaderSize);
+	uint32_t magic = 0;
+	uint8_t version = 0, opcode = 0;
+	uint16_t reserved = 0;
+	reader.u32(magic);
+	reader.u8(version);
+	reader.u8(opcode);
+	reader.u16(reserved);
+	reader.u32(out_header.payload_length);
+	if (magic != kProtocolMagic) {
+		out_error = "Bad protocol magic";
+		return false;
+	}
+	if (version != kProtocolVersion) {
+		out_error = "Unsupported protocol version";
+		return false;
+	}
+	if (opcode < static_cast<uint8_t>(Opcode::Hash) || opcode > static_cast<uint8_t>(Opcode::SetThrottle)) {
+		out_error = "Unknown opcode";
+		return false;
+	}
+	if (out_header.payload_length > kMaxPayloadSize) {
+		out_error = "Payload too large";
+		return false;
+	}
+	out_header.opcode = static_cast<Opcode>(opcode);
+	return true;
+}
+
+bool decode_request(Opcode opcode, const std::vector<unsigned char> &payload, Request &out_request, std::string &out_error) {
+	Reader reader(payload.data(), payload.size());
+	out_request = Request{};
+	out_request.opcode = opcode;
+	bool ok = true;
+	std::string path;
+	switch (opcode) {
+	case Opcode::Hash:
+		ok = reader.string(path);
+		out_request.paths.push_back(path);
+		break;
+	case Opcode::Verify:
+		ok = reader.digest(out_request.expected) && reader.string(path);
+		out_request.paths.push_back(path);
+		break;
+	case Opcode::Batch: {
+		uint32_t count = 0;
+		ok = reader.u32(count);
+		for (uint32_t i = 0; ok && i < count; ++i) {
+			ok = reader.string(path);
+			out_request.paths.push_back(path);
+		}
+		break;
+	}
+	case Opcode::Shutdown:
+		break;
+	case Opcode::SetThrottle: {
+		uint8_t background = 0;
+		ok = reader.u64(out_request.bytes_per_second) && reader.u32(out_request.max_iops) && reader.u8(background);
+		out_request.background = background != 0;
+		break;
+	}
+	}
+	if (!ok || !reader.at_end()) {
+		out_error = "Malformed request";
+		return false;
+	}
+	return true;
+}
+
+bool decode_response(Opcode opcode, const std::vector<unsigned char> &payload, Response &out_response, std::string &out_error) {
+	Reader reader(payload.data(), payload.size());
+	out_response = Response{};
+	out_response.opcode = opcode;
+	uint32_t count = 0;
+	bool ok = reader.u32(count);
+	for (uint32_t i = 0; ok && i < count; ++i) {
+		ResultRecord result;
+		uint8_t status = 0;
+		ok = reader.u8(status) && reader.u8(result.flags) && reader.u64(result.size_bytes) && reader.digest(result.digest) && reader.string(result.message);
+		result.status = static_cast<ResultStatus>(status);
+		out_response.results.push_back(std::move(result));
+	}
+	if (!ok || !reader.at_end()) {
+		out_error = "Malformed response";
+		return false;
+	}
+	return true;
+}
+
+}
@@ -0,0 +1,89 @@
+// daemon_protocol.hpp - compact binary protocol between c-hash clients and the hashing daemon
+#pragma once
+
+#include "hash.hpp"
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace hashcore {
+
+// Every message is a fixed 12-byte header followed by `payload_length` bytes.
+// All integers are little-endian; strings are u32 length + UTF-8 bytes.
+//
+//   u32 magic ("CHSH")  u8 version  u8 opcode  u16 reserved (0)  u32 payload_length
+//
+// Request payloads:
+//   Hash:     string path
+//   Verify:   u8[32] expected digest, string path
+//   Batch:    u32 count, count x string path
+//   Shutdown: (empty)
+//   SetThrottle: u64 bytes_per_second, u32 max_iops, u8 background (0 = unlimited)
+// Response payload (same opcode as the request):
+//   u32 count, count x { u8 status, u8 flags, u64 size_bytes, u8[32] digest, string message }
+//   (Shutdown: no records; SetThrottle: one record, Ok or Error)
+
+constexpr uint32_t kProtocolMagic = 0x48534843;  // "CHSH"
+constexpr uint8_t kProtocolVersion = 1;
+constexpr size_t kFrameHeaderSize = 12;
+constexpr uint32_t kMaxPayloadSize = 16 * 1024 * 1024;
+
+enum class Opcode : uint8_t {
+	Hash = 1,
+	Verify = 2,
+	Batch = 3,
+	Shutdown = 4,
+	SetThrottle = 5  // change the daemon's read limits while it runs
+};
+
+enum class ResultStatus : uint8_t {
+	Ok = 0,
+	Error = 1,
+	Mismatch = 2
+};
+
+// Response flag bits.
+constexpr uint8_t kResultFromCache = 0x01;
+constexpr uint8_t kResultCoalesced = 0x02;
+
+struct Request {
+	Opcode opcode = Opcode::Hash;
+	std::vector<std::string> paths;  // UTF-8; exactly one for Hash/Verify
+	Sha256Digest expected{};          // Verify only
+	uint64_t bytes_per_second = 0;    // SetThrottle only
+	uint32_t max_iops = 0;            // SetThrottle only
+	bool background = false;          // SetThrottle only
+};
+
+struct ResultRecord {
+	ResultStatus status = ResultStatus::Ok;
+	uint8_t flags = 0;
+	uint64_t size_bytes = 0;
+	Sha256Digest digest{};
+	std::string message;
+};
+
+struct Response {
+	Opcode opcode = Opcode::Hash;
+	std::vector<ResultRecord> results;
+};
+
+struct FrameHeader {
+	Opcode opcode = Opcode::Hash;
+	uint32_t payload_length = 0;
+};
+
+// Serialize header + payload into one buffer ready to send.
+std::vector<unsigned char> encode_request(const Request &request);
+std::vector<unsigned char> encode_response(const Response &response);
+
+// Parse a 12-byte frame header. Rejects bad magic/version and oversized payloads.
+bool decode_frame_header(const unsigned char *data, FrameHeader &out_header, std::string &out_error);
+
+// Parse a payload whose opcode came from the frame header.
+bool decode_request(Opcode opcode, const std::vector<unsigned char> &payload, Request &out_request, std::string &out_error);
+bool decode_response(Opcode opcode, const std::vector<unsigned char> &payload, Response &out_response, std::string &out_error);
+
+}
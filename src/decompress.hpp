@@ -0,0 +1,185 @@
+// decompress.hpp - optional gzip/zstd source policies (WITH_ZLIB / WITH_ZSTD)
+#pragma once
+
+#include "hash.hpp"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(HASHCORE_HAS_ZLIB)
+#include <zlib.h>
+#endif
+#if defined(HASHCORE_HAS_ZSTD)
+#include <zstd.h>
+#endif
+
+namespace hashcore {
+
+#if defined(HASHCORE_HAS_ZLIB)
+
+// Inflates a gzip (or zlib) stream read from Inner. Concatenated gzip members are supported.
+// size() reports the compressed size of the underlying file.
+template <class Inner>
+class GzipSource {
+public:
+	template <class... Args>
+	explicit GzipSource(Args &&...args) : inner_(std::forward<Args>(args)...) {}
+	GzipSource(const GzipSource &) = delete;
+	GzipSource &operator=(const GzipSource &) = delete;
+	~GzipSource() {
+		if (initialized_) {
+			inflateEnd(&stream_);
+		}
+	}
+
+	bool open(const fs::path &file_path, std::string &out_error) {
+		if (!inner_.open(file_path, out_error)) {
+			return false;
+		}
+		stream_ = z_stream{};
+		// 15 window bits + 32: detect gzip or zlib framing automatically.
+		if (inflateInit2(&stream_, 15 + 32) != Z_OK) {
+			out_error = "inflateInit2 failed";
+			return false;
+		}
+		initialized_ = true;
+		input_.resize(HASH_BUFFER_SIZE);
+		return true;
+	}
+
+	uint64_t size() const { return inner_.size(); }
+
+	bool read(unsigned char *buffer, size_t capacity, size_t &out_read, std::string &out_error) {
+		out_read = 0;
+		for (;;) {
+			if (stream_.avail_in == 0 && !input_eof_) {
+				size_t bytes_read = 0;
+				if (!inner_.read(input_.data(), input_.size(), bytes_read, out_error)) {
+					return false;
+				}
+				input_eof_ = bytes_read == 0;
+				stream_.next_in = input_.data();
+				stream_.avail_in = static_cast<uInt>(bytes_read);
+			}
+			if (member_end_) {
+				if (stream_.avail_in == 0) {
+					return true;
+				}
+				inflateReset(&stream_);
+				member_end_ = false;
+			}
+
+			stream_.next_out = buffer;
+			stream_.avail_out = static_cast<uInt>(capacity);
+			int rc = inflate(&stream_, Z_NO_FLUSH);
+			out_read = capacity - stream_.avail_out;
+			if (rc == Z_STREAM_END) {
+				member_end_ = true;
+			} else if (rc == Z_BUF_ERROR) {
+				if (out_read == 0 && input_eof_ && stream_.avail_in == 0) {
+					out_error = "Truncated gzip stream";
+					return false;
+				}
+			} else if (rc != Z_OK) {
+				out_error = "gzip decompression failed";
+				return false;
+			}
+			if (out_read > 0) {
+				return true;
+			}
+		}
+	}
+
+private:
+	Inner inner_;
+	z_stream stream_{};
+	std::vector<unsigned char> input_;
+	bool initialized_ = false;
+	bool input_eof_ = false;
+	bool member_end_ = false;
+};
+
+#endif
+
+#if defined(HASHCORE_HAS_ZSTD)
+
+// Decompresses a zstd stream (one or more frames) read from Inner.
+// size() reports the compressed size of the underlying file.
+template <class Inner>
+class ZstdSource {
+public:
+	template <class... Args>
+	explicit ZstdSource(Args &&...args) : inner_(std::forward<Args>(args)...) {}
+	ZstdSource(const ZstdSource &) = delete;
+	ZstdSource &operator=(const ZstdSource &) = delete;
+	~ZstdSource() {
+		if (context_) {
+			ZSTD_freeDCtx(context_);
+		}
+	}
+
+	bool open(const fs::path &file_path, std::string &out_error) {
+		if (!inner_.open(file_path, out_error)) {
+			return false;
+		}
+		context_ = ZSTD_createDCtx();
+		if (!context_) {
+			out_error = "ZSTD_createDCtx failed";
+			return false;
+		}
+		input_.resize(ZSTD_DStreamInSize());
+		return true;
+	}
+
+	uint64_t size() const { return inner_.size(); }
+
+	bool read(unsigned char *buffer, size_t capacity, size_t &out_read, std::string &out_error) {
+		out_read = 0;
+		for (;;) {
+			if (in_.pos == in_.size && !input_eof_) {
+				size_t bytes_read = 0;
+				if (!inner_.read(input_.data(), input_.size(), bytes_read, out_error)) {
+					return false;
+				}
+				input_eof_ = bytes_read == 0;
+				in_ = ZSTD_inBuffer{input_.data(), bytes_read, 0};
+			}
+
+			ZSTD_outBuffer out{buffer, capacity, 0};
+			size_t consumed_before = in_.pos;
+			size_t rc = ZSTD_decompressStream(context_, &out, &in_);
+			if (ZSTD_isError(rc)) {
+				out_error = "zstd decompression failed";
+				return false;
+			}
+			// rc == 0 means a frame was fully decoded and flushed; only trust it after real progress.
+			if (in_.pos != consumed_before || out.pos > 0) {
+				frame_complete_ = rc == 0;
+			}
+			out_read = out.pos;
+			if (out_read > 0) {
+				return true;
+			}
+			if (in_.pos == in_.size && input_eof_) {
+				if (!frame_complete_) {
+					out_error = "Truncated zstd stream";
+					return false;
+				}
+				return true;
+			}
+		}
+	}
+
+private:
+	Inner inner_;
+	ZSTD_DCtx *context_ = nullptr;
+	std::vector<unsigned char> input_;
+	ZSTD_inBuffer in_{nullptr, 0, 0};
+	bool input_eof_ = false;
+	bool frame_complete_ = false;
+};
+
+#endif
+
+}
@@ -1,8 +1,7 @@
 #include "hash.hpp"
+#include "hash_engine.hpp"
+#include "hash_win32.hpp"
 
-#include <windows.h>
-#include <bcrypt.h>
-#include <vector>
 #include <atomic>
 
 #if defined(_MSC_VER)
@@ -12,98 +11,9 @@
 namespace hashcore {
 
 bool compute_sha256_streamed(const fs::path &file_path, Sha256Digest &out_digest, uint64_t &out_size_bytes, double &out_elapsed_seconds, std::string &out_error) {
-	HANDLE file = CreateFileW(file_path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
-	if (file == INVALID_HANDLE_VALUE) {
-		out_error = "Failed to open file";
-		return false;
-	}
-
-	LARGE_INTEGER size{};
-	if (!GetFileSizeEx(file, &size)) {
-		CloseHandle(file);
-		out_error = "Failed to get file size";
-		return false;
-	}
-	out_size_bytes = static_cast<uint64_t>(size.QuadPart);
-
-	BCRYPT_ALG_HANDLE alg_handle = nullptr;
-	BCRYPT_HASH_HANDLE hash_handle = nullptr;
-	DWORD hash_object_len = 0, data_len = 0;
-
-	if (BCryptOpenAlgorithmProvider(&alg_handle, BCRYPT_SHA256_ALGORITHM, nullptr, 0) != 0) {
-		CloseHandle(file);
-		out_error = "BCryptOpenAlgorithmProvider failed";
-		return false;
-	}
-	if (BCryptGetProperty(alg_handle, BCRYPT_OBJECT_LENGTH, (PUCHAR)&hash_object_len, sizeof(hash_object_len), &data_len, 0) != 0) {
-		BCryptCloseAlgorithmProvider(alg_handle, 0);
-		CloseHandle(file);
-		out_error = "BCryptGetProperty(ObjectLength) failed";
-		return false;
-	}
-
-	std::vector<UCHAR> hash_object(hash_object_len);
-	if (BCryptCreateHash(alg_handle, &hash_handle, hash_object.data(), static_cast<ULONG>(hash_object.size()), nullptr, 0, 0) != 0) {
-		BCryptCloseAlgorithmProvider(alg_handle, 0);
-		CloseHandle(file);
-		out_error = "BCryptCreateHash failed";
-		return false;
-	}
-
-	std::vector<unsigned char> buffer(HASH_BUFFER_SIZE);
-
-	LARGE_INTEGER start{}, end{};
-	QueryPerformanceCounter(&start);
-	LARGE_INTEGER freq{};
-	QueryPerformanceFrequency(&freq);
-
-	DWORD bytes_read = 0;
-	BOOL read_ok = FALSE;
-	do {
-		read_ok = ReadFile(file, buffer.data(), static_cast<DWORD>(buffer.size()), &bytes_read, nullptr);
-		if (!read_ok) {
-			BCryptDestroyHash(hash_handle);
-			BCryptCloseAlgorithmProvider(alg_handle, 0);
-			CloseHandle(file);
-			out_error = "ReadFile failed";
-			return false;
-		}
-		if (bytes_read > 0) {
-			if (BCryptHashData(hash_handle, buffer.data(), bytes_read, 0) != 0) {
-				BCryptDestroyHash(hash_handle);
-				BCryptCloseAlgorithmProvider(alg_handle, 0);
-				CloseHandle(file);
-				out_error = "BCryptHashData failed";
-				return false;
-			}
-		}
-	} while (bytes_read > 0);
-
-	DWORD hash_len = 0;
-	data_len = 0;
-	if (BCryptGetProperty(alg_handle, BCRYPT_HASH_LENGTH, (PUCHAR)&hash_len, sizeof(hash_len), &data_len, 0) != 0 || hash_len != out_digest.bytes.size()) {
-		BCryptDestroyHash(hash_handle);
-		BCryptCloseAlgorithmProvider(alg_handle, 0);
-		CloseHandle(file);
-		out_error = "BCryptGetProperty(HashLength) failed";
-		return false;
-	}
-
-	if (BCryptFinishHash(hash_handle, out_digest.bytes.data(), static_cast<ULONG>(out_digest.bytes.size()), 0) != 0) {
-		BCryptDestroyHash(hash_handle);
-		BCryptCloseAlgorithmProvider(alg_handle, 0);
-		CloseHandle(file);
-		out_error = "BCryptFinishHash failed";
-		return false;
-	}
-
-	QueryPerformanceCounter(&end);
-	out_elapsed_seconds = static_cast<double>(end.QuadPart - start.QuadPart) / static_cast<double>(freq.QuadPart);
-
-	BCryptDestroyHash(hash_handle);
-	BCryptCloseAlgorithmProvider(alg_handle, 0);
-	CloseHandle(file);
-	return true;
+	Win32FileSource source;
+	NullProgress progress;
+	return hash_file<CngSha256>(source, file_path, out_digest, out_size_bytes, out_elapsed_seconds, out_error, progress);
 }
 
 bool compute_sha256_streamed_with_progress(const fs::path &file_path,
@@ -114,111 +24,17 @@ bool compute_sha256_streamed_with_progress(const fs::path &file_path,
 	std::atomic<bool> *cancel_flag,
 	ProgressCallback progress_cb,
 	void *user_data) {
-	HANDLE file = CreateFileW(file_path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
-	if (file == INVALID_HANDLE_VALUE) {
-		out_error = "Failed to open file";
-		return false;
-	}
-
-	LARGE_INTEGER size{};
-	if (!GetFileSizeEx(file, &size)) {
-		CloseHandle(file);
-		out_error = "Failed to get file size";
-		return false;
-	}
-	out_size_bytes = static_cast<uint64_t>(size.QuadPart);
-
-	BCRYPT_ALG_HANDLE alg_handle = nullptr;
-	BCRYPT_HASH_HANDLE hash_handle = nullptr;
-	DWORD hash_object_len = 0, data_len = 0;
-
-	if (BCryptOpenAlgorithmProvider(&alg_handle, BCRYPT_SHA256_ALGORITHM, nullptr, 0) != 0) {
-		CloseHandle(file);
-		out_error = "BCryptOpenAlgorithmProvider failed";
-		return false;
-	}
-	if (BCryptGetProperty(alg_handle, BCRYPT_OBJECT_LENGTH, (PUCHAR)&hash_object_len, sizeof(hash_object_len), &data_len, 0) != 0) {
-		BCryptCloseAlgorithmProvider(alg_handle, 0);
-		CloseHandle(file);
-		out_error = "BCryptGetProperty(ObjectLength) failed";
-		return false;
-	}
-
-	std::vector<UCHAR> hash_object(hash_object_len);
-	if (BCryptCreateHash(alg_handle, &hash_handle, hash_object.data(), static_cast<ULONG>(hash_object.size()), nullptr, 0, 0) != 0) {
-		BCryptCloseAlgorithmProvider(alg_handle, 0);
-		CloseHandle(file);
-		out_error = "BCryptCreateHash failed";
-		return false;
-	}
-
-	std::vector<unsigned char> buffer(HASH_BUFFER_SIZE);
-
-	LARGE_INTEGER start{}, end{};
-	QueryPerformanceCounter(&start);
-	LARGE_INTEGER freq{};
-	QueryPerformanceFrequency(&freq);
-
-	uint64_t processed = 0;
-	DWORD bytes_read = 0;
-	BOOL read_ok = FALSE;
-	do {
-		read_ok = ReadFile(file, buffer.data(), static_cast<DWORD>(buffer.size()), &bytes_read, nullptr);
-		if (!read_ok) {
-			BCryptDestroyHash(hash_handle);
-			BCryptCloseAlgorithmProvider(alg_handle, 0);
-			CloseHandle(file);
-			out_error = "ReadFile failed";
-			return false;
-		}
-		if (bytes_read > 0) {
-			if (BCryptHashData(hash_handle, buffer.data(), bytes_read, 0) != 0) {
-				BCryptDestroyHash(hash_handle);
-				BCryptCloseAlgorithmProvider(alg_handle, 0);
-				CloseHandle(file);
-				out_error = "BCryptHashData failed";
-				return false;
-			}
-			processed += bytes_read;
-			if (progress_cb) {
-				progress_cb(processed, out_size_bytes, user_data);
-			}
-			if (cancel_flag && cancel_flag->load()) {
-				BCryptDestroyHash(hash_handle);
-				BCryptCloseAlgorithmProvider(alg_handle, 0);
-				CloseHandle(file);
-				out_error = "Cancelled";
-				return false;
-			}
-		}
-	} while (bytes_read > 0);
-
-	DWORD hash_len = 0;
-	data_len = 0;
-	if (BCryptGetProperty(alg_handle, BCRYPT_HASH_LENGTH, (PUCHAR)&hash_len, sizeof(hash_len), &data_len, 0) != 0 || hash_len != out_digest.bytes.size()) {
-		BCryptDestroyHash(hash_handle);
-		BCryptCloseAlgorithmProvider(alg_handle, 0);
-		CloseHandle(file);
-		out_error = "BCryptGetProperty(HashLength) failed";
-		return false;
-	}
-
-	if (BCryptFinishHash(hash_handle, out_digest.bytes.data(), static_cast<ULONG>(out_digest.bytes.size()), 0) != 0) {
-		BCryptDestroyHash(hash_handle);
-		BCryptCloseAlgorithmProvider(alg_handle, 0);
-		CloseHandle(file);
-		out_error = "BCryptFinishHash failed";
-		return false;
-	}
-
-	QueryPerformanceCounter(&end);
-	out_elapsed_seconds = static_cast<double>(end.QuadPart - start.QuadPart) / static_cast<double>(freq.QuadPart);
-
-	BCryptDestroyHash(hash_handle);
-	BCryptCloseAlgorithmProvider(alg_handle, 0);
-	CloseHandle(file);
-	return true;
+	if (!cancel_flag && !progress_cb) {
+		return compute_sha256_streamed(file_path, out_digest, out_size_bytes, out_elapsed_seconds, out_error);
+	}
+	Win32FileSource source;
+	CallbackProgress progress;
+	progress.cancel_flag = cancel_flag;
+	progress.callback = progress_cb;
+	progress.user_data = user_data;
+	return hash_file<CngSha256>(source, file_path, out_digest, out_size_bytes, out_elapsed_seconds, out_error, progress);
 }
+
 std::string to_hex(const Sha256Digest &digest, bool uppercase) {
 	static const char *lower = "0123456789abcdef";
 	static const char *upper = "0123456789ABCDEF";
@@ -234,6 +50,27 @@ std::string to_hex(const Sha256Digest &digest, bool uppercase) {
 	return out;
 }
 
+bool from_hex(const std::string &hex, Sha256Digest &out_digest) {
+	if (hex.size() != out_digest.bytes.size() * 2) {
+		return false;
+	}
+	auto nibble = [](char c) -> int {
+		if (c >= '0' && c <= '9') return c - '0';
+		if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+		if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+		return -1;
+	};
+	for (size_t i = 0; i < out_digest.bytes.size(); ++i) {
+		int high = nibble(hex[i * 2]);
+		int low = nibble(hex[i * 2 + 1]);
+		if (high < 0 || low < 0) {
+			return false;
+		}
+		out_digest.bytes[i] = static_cast<unsigned char>((high << 4) | low);
+	}
+	return true;
+}
+
 std::string to_base64(const Sha256Digest &digest) {
 	static const char table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
 	std::string out;
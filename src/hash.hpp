@@ -41,6 +41,9 @@ bool compute_sha256_streamed_with_progress(const fs::path &file_path,
 // Convert digest to hex string (upper/lower per flag).
 std::string to_hex(const Sha256Digest &digest, bool uppercase);
 
+// Parse a 64-character hex string (either case) into a digest. Returns false if malformed.
+bool from_hex(const std::string &hex, Sha256Digest &out_digest);
+
 // Convert digest to Base64 string.
 std::string to_base64(const Sha256Digest &digest);
 
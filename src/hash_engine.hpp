@@ -0,0 +1,111 @@
+// hash_engine.hpp - templated streaming engine shared by all hashing entry points
+#pragma once
+
+#include "hash.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace hashcore {
+
+// The engine is parameterized by three policies:
+// - Source:   bool open(path, error); uint64_t size() const;
+//             bool read(buffer, capacity, out_read, error)  (out_read == 0 means EOF)
+// - Digest:   using result_type; bool init(error); bool update(data, length, error);
+//             bool finish(result_type &, error)  (leaves the digest ready for a new message)
+// - Progress: static constexpr bool enabled; bool on_chunk(processed, total)  (false = cancel)
+// A policy with enabled == false is never touched inside the loop, so it costs nothing.
+
+// Progress policy that reports nothing and never cancels.
+struct NullProgress {
+	static constexpr bool enabled = false;
+	bool on_chunk(uint64_t, uint64_t) { return true; }
+};
+
+// Progress policy that forwards to a ProgressCallback and polls a cancel flag.
+struct CallbackProgress {
+	static constexpr bool enabled = true;
+
+	std::atomic<bool> *cancel_flag = nullptr;
+	ProgressCallback callback = nullptr;
+	void *user_data = nullptr;
+
+	bool on_chunk(uint64_t processed_bytes, uint64_t total_bytes) {
+		if (callback) {
+			callback(processed_bytes, total_bytes, user_data);
+		}
+		return !(cancel_flag && cancel_flag->load(std::memory_order_relaxed));
+	}
+};
+
+static_assert(std::is_empty<NullProgress>::value, "NullProgress must stay stateless");
+
+// Pump every byte of an already opened source through an initialized digest.
+// Returns false on read/digest failure or cancellation ("Cancelled").
+template <class Source, class Digest, class Progress>
+bool stream_into(Source &source, Digest &digest, Progress &progress,
+	unsigned char *buffer, size_t buffer_size,
+	uint64_t total_bytes, std::string &out_error) {
+	uint64_t processed = 0;
+	for (;;) {
+		size_t bytes_read = 0;
+		if (!source.read(buffer, buffer_size, bytes_read, out_error)) {
+			return false;
+		}
+		if (bytes_read == 0) {
+			return true;
+		}
+		if (!digest.update(buffer, bytes_read, out_error)) {
+			return false;
+		}
+		if constexpr (Progress::enabled) {
+			processed += bytes_read;
+			if (!progress.on_chunk(processed, total_bytes)) {
+				out_error = "Cancelled";
+				return false;
+			}
+		} else {
+			(void)processed;
+			(void)total_bytes;
+		}
+	}
+}
+
+// Open `source` on a file, then digest and time it. Elapsed covers the read/digest loop and finalization.
+template <class Digest, class Source, class Progress>
+bool hash_file(Source &source,
+	const fs::path &file_path,
+	typename Digest::result_type &out_digest,
+	uint64_t &out_size_bytes,
+	double &out_elapsed_seconds,
+	std::string &out_error,
+	Progress &progress) {
+	if (!source.open(file_path, out_error)) {
+		return false;
+	}
+	out_size_bytes = source.size();
+
+	Digest digest;
+	if (!digest.init(out_error)) {
+		return false;
+	}
+
+	std::vector<unsigned char> buffer(HASH_BUFFER_SIZE);
+
+	auto start = std::chrono::steady_clock::now();
+	if (!stream_into(source, digest, progress, buffer.data(), buffer.size(), out_size_bytes, out_error)) {
+		return false;
+	}
+	if (!digest.finish(out_digest, out_error)) {
+		return false;
+	}
+	auto end = std::chrono::steady_clock::now();
+	out_elapsed_seconds = std::chrono::duration<double>(end - start).count();
+	return true;
+}
+
+}
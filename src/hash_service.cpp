@@ -0,0 +1,319 @@
+#include "hash_service.hpp"
+#include "hash_engine.hpp"
+#include "hash_win32.hpp"
+#include "throttle.hpp"
+
+#include <algorithm>
+#include <memory>
+
+namespace hashcore {
+
+namespace {
+
+unsigned resolve_worker_count(unsigned requested) {
+	return requested ? requested : std::max(1u, std::thread::hardware_concurrency());
+}
+
+std::shared_future<FileHashResult> ready_result(FileHashResult result) {
+	std::promise<FileHashResult> promise;
+	promise.set_value(std::move(result));
+	return promise.get_future().share();
+}
+
+FileHashResult error_result(const std::string &error) {
+	FileHashResult result;
+	result.error = error;
+	return result;
+}
+
+}
+
+BufferPool::BufferPool(size_t count) {
+	free_.reserve(count);
+	for (size_t i = 0; i < count; ++i) {
+		free_.emplace_back(HASH_BUFFER_SIZE);
+	}
+}
+
+std::vector<unsigned char> BufferPool::acquire() {
+	std::unique_lock<std::mutex> lock(mutex_);
+	cv_.wait(lock, [this]() { return !free_.empty(); });
+	std::vector<unsigned char> buffer = std::move(free_.back());
+	free_.pop_back();
+	return buffer;
+}
+
+void BufferPool::release(std::vector<unsigned char> buffer) {
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		free_.push_back(std::move(buffer));
+	}
+	cv_.notify_one();
+}
+
+HashService::HashService(const ServiceOptions &options)
+	: options_(options),
+	  buffers_(options.pin_workers ? 0 : resolve_worker_count(options.worker_count)) {
+	options_.worker_count = resolve_worker_count(options.worker_count);
+	std::string topology_error;
+	pinned_ = options_.pin_workers && query_cpu_topology(topology_, topology_error) && !topology_.slots.empty();
+	queues_.resize(1 + (pinned_ ? topology_.node_numbers.size() : 0));
+	idle_.resize(queues_.size());
+	if (pinned_) {
+		std::vector<bool> used(topology_.node_numbers.size());
+		for (unsigned i = 0; i < options_.worker_count; ++i) {
+			used[topology_.slots[i % topology_.slots.size()].node_index] = true;
+		}
+		stats_.pinned_nodes = static_cast<uint32_t>(std::count(used.begin(), used.end(), true));
+	}
+	for (unsigned i = 0; i < options_.worker_count; ++i) {
+		workers_.emplace_back([this, i]() { worker_loop(i); });
+	}
+}
+
+HashService::~HashService() {
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		stopping_ = true;
+	}
+	jobs_cv_.notify_all();
+	for (auto &worker : workers_) {
+		worker.join();
+	}
+}
+
+std::shared_future<FileHashResult> HashService::submit(const fs::path &file_path, bool *out_coalesced) {
+	if (out_coalesced) {
+		*out_coalesced = false;
+	}
+	FileIdentity identity;
+	std::string error;
+	if (!query_file_identity(file_path, identity, error)) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		++stats_.requests;
+		return ready_result(error_result(error));
+	}
+	FileKey key{identity.volume, identity.file_index};
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	++stats_.requests;
+
+	auto cached = cache_.find(key);
+	if (cached != cache_.end()) {
+		CacheEntry &entry = cached->second;
+		if (entry.size_bytes == identity.size_bytes && entry.last_write_time == identity.last_write_time) {
+			lru_.splice(lru_.begin(), lru_, entry.lru_position);
+			++stats_.cache_hits;
+			FileHashResult result;
+			result.success = true;
+			result.from_cache = true;
+			result.size_bytes = entry.size_bytes;
+			result.digest = entry.digest;
+			return ready_result(result);
+		}
+	}
+
+	auto running = in_flight_.find(key);
+	if (running != in_flight_.end() && running->second->size_bytes == identity.size_bytes && running->second->last_write_time == identity.last_write_time) {
+		++stats_.coalesced;
+		if (out_coalesced) {
+			*out_coalesced = true;
+		}
+		return running->second->future;
+	}
+
+	if (stopping_) {
+		return ready_result(error_result("Service is shutting down"));
+	}
+
+	auto in_flight = std::make_shared<InFlight>();
+	in_flight->size_bytes = identity.size_bytes;
+	in_flight->last_write_time = identity.last_write_time;
+	in_flight->future = in_flight->promise.get_future().share();
+	in_flight_[key] = in_flight;
+
+	size_t queue = 0;
+	if (pinned_) {
+		auto routed = options_.volume_nodes.find(identity.volume);
+		if (routed != options_.volume_nodes.end()) {
+			uint32_t node_index = topology_.node_index(routed->second);
+			if (node_index != kAnyNode) {
+				queue = 1 + node_index;
+			}
+		}
+	}
+	queues_[queue].push_back(Job{file_path, key, in_flight});
+	if (queue == 0) {
+		jobs_cv_.notify_one();
+	} else {
+		// Only the owning node's workers take it straight away; wake them all.
+		jobs_cv_.notify_all();
+	}
+	return in_flight->future;
+}
+
+ServiceStats HashService::stats() const {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return stats_;
+}
+
+void HashService::worker_loop(unsigned index) {
+	size_t home_queue = 0;
+	uint32_t node = kAnyNode;
+	if (pinned_) {
+		const CpuSlot &slot = topology_.slots[index % topology_.slots.size()];
+		if (pin_current_thread(slot)) {
+			home_queue = 1 + slot.node_index;
+			node = slot.node;
+			std::lock_guard<std::mutex> lock(mutex_);
+			++stats_.pinned_workers;
+		}
+	}
+
+	// Allocated after pinning so the pages land on this worker's node.
+	NodeLocalBuffer local_buffer;
+	std::string buffer_error;
+	bool own_buffer = options_.pin_workers;
+	bool buffer_ready = !own_buffer || local_buffer.allocate(HASH_BUFFER_SIZE, node, buffer_error);
+
+	auto digest = std::make_unique<CngSha256>();
+	std::string digest_error;
+	bool digest_ready = digest->init(digest_error);
+
+	for (;;) {
+		Job job;
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			bool have_job = false;
+			++idle_[home_queue];
+			jobs_cv_.wait(lock, [&]() {
+				have_job = take_job_locked(home_queue, job);
+				return have_job || stopping_;
+			});
+			--idle_[home_queue];
+			if (!have_job) {
+				return;
+			}
+			// Last free worker of this node and routed work is still queued: let other nodes steal it.
+			if (home_queue != 0 && idle_[home_queue] == 0 && !queues_[home_queue].empty()) {
+				jobs_cv_.notify_all();
+			}
+		}
+
+		if (!digest_ready) {
+			complete(job, error_result(digest_error));
+			continue;
+		}
+		if (!buffer_ready) {
+			complete(job, error_result(buffer_error));
+			continue;
+		}
+
+		FileHashResult result;
+		std::vector<unsigned char> pooled;
+		unsigned char *buffer = local_buffer.data();
+		size_t buffer_size = local_buffer.size();
+		if (!own_buffer) {
+			pooled = buffers_.acquire();
+			buffer = pooled.data();
+			buffer_size = pooled.size();
+		}
+		// Producers may rename or delete the file mid-hash (e.g. x.part -> x); complete()
+		// re-checks the identity before caching the result.
+		ThrottledSource<Win32FileSource> source(options_.throttle, FILE_SHARE_READ | FILE_SHARE_DELETE);
+		NullProgress progress;
+		if (source.open(job.path, result.error)) {
+			result.size_bytes = source.size();
+			result.success = stream_into(source, *digest, progress, buffer, buffer_size, result.size_bytes, result.error)
+				&& digest->finish(result.digest, result.error);
+		}
+		if (!own_buffer) {
+			buffers_.release(std::move(pooled));
+		}
+
+		if (!result.success) {
+			// A failed read leaves a partial message in the hash object; start the next job fresh.
+			digest = std::make_unique<CngSha256>();
+			digest_ready = digest->init(digest_error);
+		}
+		complete(job, std::move(result));
+	}
+}
+
+// Own node's routed jobs first, then unrouted jobs, then another node's routed jobs if
+// none of that node's workers is idle to take them.
+bool HashService::take_job_locked(size_t queue, Job &out_job) {
+	size_t from = queues_.size();
+	if (queue != 0 && !queues_[queue].empty()) {
+		from = queue;
+		++stats_.routed_local;
+	} else if (!queues_[0].empty()) {
+		from = 0;
+	} else {
+		for (size_t q = 1; q < queues_.size(); ++q) {
+			if (q != queue && !queues_[q].empty() && idle_[q] == 0) {
+				from = q;
+				++stats_.routed_stolen;
+				break;
+			}
+		}
+	}
+	if (from == queues_.size()) {
+		return false;
+	}
+	out_job = std::move(queues_[from].front());
+	queues_[from].pop_front();
+	return true;
+}
+
+void HashService::complete(const Job &job, FileHashResult result) {
+	// Only cache if the file did not change while it was being read.
+	FileIdentity after;
+	std::string ignored;
+	bool unchanged = result.success
+		&& query_file_identity(job.path, after, ignored)
+		&& after.volume == job.key.volume
+		&& after.file_index == job.key.file_index
+		&& after.size_bytes == job.in_flight->size_bytes
+		&& after.last_write_time == job.in_flight->last_write_time;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (result.success) {
+			++stats_.files_hashed;
+			stats_.bytes_hashed += result.size_bytes;
+		}
+		if (unchanged) {
+			cache_store_locked(job.key, result.size_bytes, job.in_flight->last_write_time, result.digest);
+		}
+		auto running = in_flight_.find(job.key);
+		if (running != in_flight_.end() && running->second == job.in_flight) {
+			in_flight_.erase(running);
+		}
+	}
+	job.in_flight->promise.set_value(std::move(result));
+}
+
+void HashService::cache_store_locked(const FileKey &key, uint64_t size_bytes, uint64_t last_write_time, const Sha256Digest &digest) {
+	if (options_.cache_capacity == 0) {
+		return;
+	}
+	auto existing = cache_.find(key);
+	if (existing != cache_.end()) {
+		lru_.erase(existing->second.lru_position);
+		cache_.erase(existing);
+	}
+	while (cache_.size() >= options_.cache_capacity && !lru_.empty()) {
+		cache_.erase(lru_.back());
+		lru_.pop_back();
+	}
+	lru_.push_front(key);
+	CacheEntry entry;
+	entry.size_bytes = size_bytes;
+	entry.last_write_time = last_write_time;
+	entry.digest = digest;
+	entry.lru_position = lru_.begin();
+	cache_.emplace(key, entry);
+}
+
+}
@@ -0,0 +1,137 @@
+// hash_service.hpp - shared worker pool, buffer pool and digest cache for long-running hashing
+#pragma once
+
+#include "hash.hpp"
+#include "topology.hpp"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace hashcore {
+
+class Throttle;
+
+struct ServiceOptions {
+	unsigned worker_count = 0;       // 0 = std::thread::hardware_concurrency()
+	size_t cache_capacity = 65536;   // digests kept in the LRU cache
+	Throttle *throttle = nullptr;    // optional, shared by every worker
+	// Pin each worker to its own core (spread across NUMA nodes) and give it a read buffer
+	// on its local node. Off by default so pinned and unpinned runs can be compared.
+	bool pin_workers = false;
+	// Volume serial -> OS NUMA node nearest that volume's storage controller. With pinned
+	// workers, files on a listed volume are queued for that node's workers first.
+	std::unordered_map<uint64_t, uint32_t> volume_nodes;
+};
+
+struct FileHashResult {
+	bool success = false;
+	bool from_cache = false;
+	uint64_t size_bytes = 0;
+	Sha256Digest digest{};
+	std::string error;
+};
+
+struct ServiceStats {
+	uint64_t requests = 0;
+	uint64_t cache_hits = 0;
+	uint64_t coalesced = 0;
+	uint64_t files_hashed = 0;
+	uint64_t bytes_hashed = 0;
+	uint32_t pinned_workers = 0;
+	uint32_t pinned_nodes = 0;   // NUMA nodes the pinned workers are spread across
+	uint64_t routed_local = 0;   // node-routed jobs run by a worker on that node
+	uint64_t routed_stolen = 0;  // node-routed jobs taken by another node because its workers were busy
+};
+
+// Fixed set of HASH_BUFFER_SIZE read buffers handed out to workers.
+class BufferPool {
+public:
+	explicit BufferPool(size_t count);
+	std::vector<unsigned char> acquire();
+	void release(std::vector<unsigned char> buffer);
+
+private:
+	std::mutex mutex_;
+	std::condition_variable cv_;
+	std::vector<std::vector<unsigned char>> free_;
+};
+
+// Hashes files on a fixed worker pool. Results are cached by file identity (volume + file
+// index) and invalidated by size or last-write-time changes. Concurrent requests for the
+// same file version share a single read. With ServiceOptions::pin_workers, workers own
+// node-local buffers instead of drawing from the shared BufferPool.
+class HashService {
+public:
+	explicit HashService(const ServiceOptions &options);
+	HashService(const HashService &) = delete;
+	HashService &operator=(const HashService &) = delete;
+	~HashService();
+
+	// out_coalesced (optional) is set when the request joined a read already in flight.
+	std::shared_future<FileHashResult> submit(const fs::path &file_path, bool *out_coalesced = nullptr);
+	FileHashResult hash(const fs::path &file_path) { return submit(file_path).get(); }
+
+	ServiceStats stats() const;
+
+private:
+	struct FileKey {
+		uint64_t volume = 0;
+		uint64_t file_index = 0;
+		bool operator==(const FileKey &other) const { return volume == other.volume && file_index == other.file_index; }
+	};
+	struct FileKeyHash {
+		size_t operator()(const FileKey &key) const { return std::hash<uint64_t>()(key.volume * 0x9E3779B97F4A7C15ULL ^ key.file_index); }
+	};
+	struct CacheEntry {
+		uint64_t size_bytes = 0;
+		uint64_t last_write_time = 0;
+		Sha256Digest digest{};
+		std::list<FileKey>::iterator lru_position;
+	};
+	struct InFlight {
+		uint64_t size_bytes = 0;
+		uint64_t last_write_time = 0;
+		std::promise<FileHashResult> promise;
+		std::shared_future<FileHashResult> future;
+	};
+	struct Job {
+		fs::path path;
+		FileKey key;
+		std::shared_ptr<InFlight> in_flight;
+	};
+
+	void worker_loop(unsigned index);
+	bool take_job_locked(size_t queue, Job &out_job);
+	void complete(const Job &job, FileHashResult result);
+	void cache_store_locked(const FileKey &key, uint64_t size_bytes, uint64_t last_write_time, const Sha256Digest &digest);
+
+	ServiceOptions options_;
+	BufferPool buffers_;
+
+	mutable std::mutex mutex_;
+	std::condition_variable jobs_cv_;
+	// queues_[0] takes unrouted jobs; queues_[1 + n] holds jobs routed to node index n.
+	// idle_[q] counts workers waiting whose home queue is q (0 for unpinned workers).
+	std::vector<std::deque<Job>> queues_;
+	std::vector<unsigned> idle_;
+	bool stopping_ = false;
+	CpuTopology topology_;
+	bool pinned_ = false;
+	std::vector<std::thread> workers_;
+
+	std::unordered_map<FileKey, CacheEntry, FileKeyHash> cache_;
+	std::list<FileKey> lru_;  // front = most recently used
+	std::unordered_map<FileKey, std::shared_ptr<InFlight>, FileKeyHash> in_flight_;
+	ServiceStats stats_;
+};
+
+}
@@ -0,0 +1,154 @@
+// hash_win32.hpp - Win32 file source and CNG digest policies for the hashing engine
+#pragma once
+
+#include "hash.hpp"
+
+#include <windows.h>
+#include <bcrypt.h>
+#include <string>
+#include <vector>
+
+namespace hashcore {
+
+// Sequential-scan file reader backed by CreateFileW/ReadFile. By default writers, renames
+// and deletes are refused while the file is open; pass FILE_SHARE_READ | FILE_SHARE_DELETE
+// to let other processes rename or delete it mid-read.
+class Win32FileSource {
+public:
+	explicit Win32FileSource(DWORD share_mode = FILE_SHARE_READ) : share_mode_(share_mode) {}
+	Win32FileSource(const Win32FileSource &) = delete;
+	Win32FileSource &operator=(const Win32FileSource &) = delete;
+	~Win32FileSource() {
+		if (handle_ != INVALID_HANDLE_VALUE) {
+			CloseHandle(handle_);
+		}
+	}
+
+	bool open(const fs::path &file_path, std::string &out_error) {
+		handle_ = CreateFileW(file_path.wstring().c_str(), GENERIC_READ, share_mode_, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (handle_ == INVALID_HANDLE_VALUE) {
+			out_error = "Failed to open file";
+			return false;
+		}
+		LARGE_INTEGER size{};
+		if (!GetFileSizeEx(handle_, &size)) {
+			out_error = "Failed to get file size";
+			return false;
+		}
+		size_ = static_cast<uint64_t>(size.QuadPart);
+		return true;
+	}
+
+	uint64_t size() const { return size_; }
+
+	bool read(unsigned char *buffer, size_t capacity, size_t &out_read, std::string &out_error) {
+		DWORD bytes_read = 0;
+		if (!ReadFile(handle_, buffer, static_cast<DWORD>(capacity), &bytes_read, nullptr)) {
+			out_error = "ReadFile failed";
+			return false;
+		}
+		out_read = bytes_read;
+		return true;
+	}
+
+private:
+	HANDLE handle_ = INVALID_HANDLE_VALUE;
+	uint64_t size_ = 0;
+	DWORD share_mode_;
+};
+
+// Stable identity of a file plus the attributes that invalidate a cached digest.
+struct FileIdentity {
+	uint64_t volume = 0;
+	uint64_t file_index = 0;
+	uint64_t size_bytes = 0;
+	uint64_t last_write_time = 0;  // FILETIME ticks
+};
+
+// Read a file's identity without opening it for data access.
+inline bool query_file_identity(const fs::path &file_path, FileIdentity &out_identity, std::string &out_error) {
+	HANDLE handle = CreateFileW(file_path.wstring().c_str(), FILE_READ_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, nullptr);
+	if (handle == INVALID_HANDLE_VALUE) {
+		out_error = "Failed to open file";
+		return false;
+	}
+	BY_HANDLE_FILE_INFORMATION info{};
+	BOOL ok = GetFileInformationByHandle(handle, &info);
+	CloseHandle(handle);
+	if (!ok) {
+		out_error = "GetFileInformationByHandle failed";
+		return false;
+	}
+	if (info.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+		out_error = "Not a regular file";
+		return false;
+	}
+	out_identity.volume = info.dwVolumeSerialNumber;
+	out_identity.file_index = (static_cast<uint64_t>(info.nFileIndexHigh) << 32) | info.nFileIndexLow;
+	out_identity.size_bytes = (static_cast<uint64_t>(info.nFileSizeHigh) << 32) | info.nFileSizeLow;
+	out_identity.last_write_time = (static_cast<uint64_t>(info.ftLastWriteTime.dwHighDateTime) << 32) | info.ftLastWriteTime.dwLowDateTime;
+	return true;
+}
+
+// SHA-256 via Windows CNG (bcrypt). Handles are released on destruction.
+// The hash object is reusable: after finish() it is ready for the next message.
+class CngSha256 {
+public:
+	using result_type = Sha256Digest;
+
+	CngSha256() = default;
+	CngSha256(const CngSha256 &) = delete;
+	CngSha256 &operator=(const CngSha256 &) = delete;
+	~CngSha256() {
+		if (hash_handle_) BCryptDestroyHash(hash_handle_);
+		if (alg_handle_) BCryptCloseAlgorithmProvider(alg_handle_, 0);
+	}
+
+	bool init(std::string &out_error) {
+		if (BCryptOpenAlgorithmProvider(&alg_handle_, BCRYPT_SHA256_ALGORITHM, nullptr, 0) != 0) {
+			alg_handle_ = nullptr;
+			out_error = "BCryptOpenAlgorithmProvider failed";
+			return false;
+		}
+		DWORD hash_object_len = 0, data_len = 0;
+		if (BCryptGetProperty(alg_handle_, BCRYPT_OBJECT_LENGTH, (PUCHAR)&hash_object_len, sizeof(hash_object_len), &data_len, 0) != 0) {
+			out_error = "BCryptGetProperty(ObjectLength) failed";
+			return false;
+		}
+		hash_object_.resize(hash_object_len);
+		if (BCryptCreateHash(alg_handle_, &hash_handle_, hash_object_.data(), static_cast<ULONG>(hash_object_.size()), nullptr, 0, BCRYPT_HASH_REUSABLE_FLAG) != 0) {
+			hash_handle_ = nullptr;
+			out_error = "BCryptCreateHash failed";
+			return false;
+		}
+		return true;
+	}
+
+	bool update(const unsigned char *data, size_t length, std::string &out_error) {
+		if (BCryptHashData(hash_handle_, const_cast<PUCHAR>(data), static_cast<ULONG>(length), 0) != 0) {
+			out_error = "BCryptHashData failed";
+			return false;
+		}
+		return true;
+	}
+
+	bool finish(Sha256Digest &out_digest, std::string &out_error) {
+		DWORD hash_len = 0, data_len = 0;
+		if (BCryptGetProperty(alg_handle_, BCRYPT_HASH_LENGTH, (PUCHAR)&hash_len, sizeof(hash_len), &data_len, 0) != 0 || hash_len != out_digest.bytes.size()) {
+			out_error = "BCryptGetProperty(HashLength) failed";
+			return false;
+		}
+		if (BCryptFinishHash(hash_handle_, out_digest.bytes.data(), static_cast<ULONG>(out_digest.bytes.size()), 0) != 0) {
+			out_error = "BCryptFinishHash failed";
+			return false;
+		}
+		return true;
+	}
+
+private:
+	BCRYPT_ALG_HANDLE alg_handle_ = nullptr;
+	BCRYPT_HASH_HANDLE hash_handle_ = nullptr;
+	std::vector<UCHAR> hash_object_;
+};
+
+}
@@ -6,16 +6,304 @@
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <atomic>
+#include <chrono>
 #include <cwchar>
+#include <cstdlib>
+#include <cerrno>
+#include <climits>
+#include <cmath>
+#include <cwctype>
+#include <vector>
 #include "hash.hpp"
+#include "throttle.hpp"
+#include "archive.hpp"
+#include "daemon.hpp"
+#include "snapshot.hpp"
+#include "watch.hpp"
+#include "topology.hpp"
 
 namespace fs = std::filesystem;
 
 static void print_usage() {
 	std::cout << "c-hash v0.1.0\n";
-	std::cout << "Usage: c-hash [-u] <file_path>\n";
-	std::cout << "  -u    Uppercase HEX output\n";
+	std::cout << "Usage: c-hash [-u] [--tar] [--rate <MiB/s>] [--iops <n>] [--background] <file_path>\n";
+	std::cout << "       c-hash --daemon [--socket <path>] [--workers <n>] [--cache <n>] [throttle options]\n";
+	std::cout << "       c-hash --client [--socket <path>] [-u] [--verify <hex>] <file_path>...\n";
+	std::cout << "       c-hash --client [--socket <path>] --stop\n";
+	std::cout << "       c-hash --client [--socket <path>] --set-throttle [throttle options]\n";
+	std::cout << "       c-hash --snapshot <out.snap> [--baseline <old.snap>] [--trust-dir-mtime] [--workers <n>] [placement options] [throttle options] <directory>\n";
+	std::cout << "       c-hash --watch [--settle <ms>] [--workers <n>] [placement options] [throttle options] <directory>\n";
+	std::cout << "       c-hash --bench [--workers <n>] [placement options] [throttle options] <file_path>...\n";
+	std::cout << "  -u            Uppercase HEX output\n";
+	std::cout << "  --tar         Treat the file as a tar/tar.gz/tar.zst archive and hash each member\n";
+	std::cout << "  --rate N      Limit read bandwidth to N MiB/s (at most 1048576)\n";
+	std::cout << "  --iops N      Limit reads to N per second\n";
+	std::cout << "  --background  Read with background (low I/O and CPU) priority\n";
+	std::cout << "  --daemon      Serve hash/verify/batch requests on a Unix domain socket\n";
+	std::cout << "  --client      Send the request to a running daemon instead of hashing locally\n";
+	std::cout << "  --socket P    Daemon socket path (default: %TEMP%\\c-hash.sock)\n";
+	std::cout << "  --workers N   Hashing threads (default: one per CPU)\n";
+	std::cout << "  --cache N     Daemon digest cache entries (default: 65536)\n";
+	std::cout << "  --verify HEX  Compare the file against an expected SHA-256\n";
+	std::cout << "  --stop        Ask the daemon to shut down\n";
+	std::cout << "  --set-throttle  Replace the daemon's throttle limits while it runs (no options = unlimited)\n";
+	std::cout << "  --snapshot F  Write a Merkle snapshot of a directory tree to F\n";
+	std::cout << "  --baseline F  Reuse digests from snapshot F and report A/D/M/E changes against it\n";
+	std::cout << "  --trust-dir-mtime  Skip listing directories whose timestamp is unchanged\n";
+	std::cout << "  --watch       Hash files in a directory tree as they are written, until Ctrl+C\n";
+	std::cout << "  --settle MS   Quiet period before a changed file is hashed (default: 250)\n";
+	std::cout << "  --bench       Hash files on the worker pool without caching and report aggregate throughput\n";
+	std::cout << "  --pin         Pin workers to cores across NUMA nodes with node-local buffers (daemon, watch, bench, snapshot)\n";
+	std::cout << "  --node V=N    Prefer NUMA node N's workers for files on the volume holding path V (with --pin)\n";
+	std::cout << "  --            End of options; later arguments are paths even if they start with '-'\n";
 	std::cout << "Outputs: HEX, Base64, size, elapsed, throughput\n";
+	std::cout << "With --tar or --client: one \"HEX  name\" line per file, then a summary\n";
+	std::cout << "With --snapshot: exit code 4 if anything changed since the baseline\n";
+	std::cout << "With --watch: one \"HEX  name\" line per settled file, \"-  name\" per removal\n";
+}
+
+static std::atomic<bool> g_watch_stop{false};
+
+static BOOL WINAPI on_console_ctrl(DWORD ctrl_type) {
+	if (ctrl_type == CTRL_C_EVENT || ctrl_type == CTRL_BREAK_EVENT || ctrl_type == CTRL_CLOSE_EVENT) {
+		g_watch_stop.store(true);
+		return TRUE;
+	}
+	return FALSE;
+}
+
+static void print_watch_record(const hashcore::WatchRecord &record, void *user_data) {
+	bool uppercase_hex = *static_cast<const bool *>(user_data);
+	if (record.removed) {
+		std::cout << "-  " << record.path << std::endl;
+	} else if (!record.success) {
+		std::cerr << "Error: " << record.error << ": " << record.path << "\n";
+	} else {
+		std::cout << hashcore::to_hex(record.digest, uppercase_hex) << "  " << record.path << std::endl;
+	}
+}
+
+static int run_watch_mode(const fs::path &root, unsigned long settle_ms, bool uppercase_hex, const hashcore::ServiceOptions &service) {
+	hashcore::WatchOptions options;
+	options.settle_delay = std::chrono::milliseconds(settle_ms);
+	options.service = service;
+	SetConsoleCtrlHandler(on_console_ctrl, TRUE);
+	std::string error;
+	bool ok = hashcore::watch_directory(root, options, g_watch_stop, print_watch_record, &uppercase_hex, error);
+	SetConsoleCtrlHandler(on_console_ctrl, FALSE);
+	if (!ok) {
+		std::cerr << "Error: " << error << "\n";
+		return 3;
+	}
+	return 0;
+}
+
+static int run_snapshot_mode(const fs::path &root, const fs::path &output_path, const fs::path &baseline_path, bool trust_directory_mtime, bool uppercase_hex, const hashcore::ServiceOptions &service) {
+	hashcore::SnapshotOptions options;
+	options.trust_directory_mtime = trust_directory_mtime;
+	options.service = service;
+	options.service.cache_capacity = 0;  // digests are reused through the baseline
+	std::vector<hashcore::SnapshotChange> changes;
+	hashcore::SnapshotStats stats;
+	std::string error;
+	if (!hashcore::update_snapshot(root, baseline_path, output_path, options, changes, stats, error)) {
+		std::cerr << "Error: " << error << "\n";
+		return 3;
+	}
+
+	static const char kChangeCodes[] = {'A', 'D', 'M', 'E'};
+	for (const auto &change : changes) {
+		std::cout << kChangeCodes[static_cast<int>(change.kind)] << "  " << change.path << (change.directory ? "/" : "");
+		if (!change.message.empty()) {
+			std::cout << ": " << change.message;
+		}
+		std::cout << "\n";
+	}
+	std::cerr << "Root: " << hashcore::to_hex(stats.root_digest, uppercase_hex) << "\n";
+	std::cerr << "Directories: " << stats.directories_listed << " listed, " << stats.directories_reused << " reused\n";
+	std::cerr << "Files: " << stats.files_hashed << " hashed (" << stats.bytes_hashed << " bytes), " << stats.files_reused << " reused\n";
+	return changes.empty() ? 0 : 4;
+}
+
+static int run_bench_mode(const std::vector<fs::path> &paths, bool uppercase_hex, const hashcore::ServiceOptions &service) {
+	hashcore::ServiceOptions options = service;
+	options.cache_capacity = 0;  // every run reads the files
+	hashcore::HashService hash_service(options);
+
+	auto start = std::chrono::steady_clock::now();
+	std::vector<std::shared_future<hashcore::FileHashResult>> pending;
+	for (const auto &path : paths) {
+		pending.push_back(hash_service.submit(path));
+	}
+	int exit_code = 0;
+	for (size_t i = 0; i < pending.size(); ++i) {
+		const hashcore::FileHashResult &result = pending[i].get();
+		if (!result.success) {
+			std::cerr << "Error: " << result.error << ": " << paths[i].u8string() << "\n";
+			exit_code = 3;
+			continue;
+		}
+		std::cout << hashcore::to_hex(result.digest, uppercase_hex) << "  " << paths[i].u8string() << "\n";
+	}
+	double elapsed_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	hashcore::ServiceStats stats = hash_service.stats();
+	double mb = static_cast<double>(stats.bytes_hashed) / (1024.0 * 1024.0);
+	double throughput = elapsed_s > 0.0 ? (mb / elapsed_s) : 0.0;
+	if (stats.pinned_workers > 0) {
+		std::cerr << "Workers: " << stats.pinned_workers << " pinned across " << stats.pinned_nodes << " NUMA node(s)\n";
+	} else {
+		std::cerr << "Workers: unpinned\n";
+	}
+	if (!options.volume_nodes.empty()) {
+		std::cerr << "Routed: " << stats.routed_local << " local, " << stats.routed_stolen << " stolen\n";
+	}
+	std::cerr << "Files: " << stats.files_hashed << " (" << stats.bytes_hashed << " bytes)\n";
+	std::cerr << "Elapsed: " << elapsed_s << " s\n";
+	std::cerr << "Throughput: " << throughput << " MiB/s\n";
+	return exit_code;
+}
+
+static int run_tar_mode(const fs::path &path, bool uppercase_hex, hashcore::Throttle *throttle) {
+	std::vector<hashcore::ArchiveMemberDigest> members;
+	uint64_t archive_bytes = 0;
+	double elapsed_s = 0.0;
+	std::string error;
+	if (!hashcore::hash_tar_members(path, hashcore::ArchiveCompression::Auto, members, archive_bytes, elapsed_s, error, throttle)) {
+		std::cerr << "Error: " << error << "\n";
+		return 3;
+	}
+
+	uint64_t member_bytes = 0;
+	for (const auto &member : members) {
+		std::cout << hashcore::to_hex(member.digest, uppercase_hex) << "  " << member.name << "\n";
+		member_bytes += member.size_bytes;
+	}
+	double mb = static_cast<double>(archive_bytes) / (1024.0 * 1024.0);
+	double throughput = elapsed_s > 0.0 ? (mb / elapsed_s) : 0.0;
+	std::cerr << "Members: " << members.size() << " (" << member_bytes << " bytes)\n";
+	std::cerr << "Archive: " << archive_bytes << " bytes\n";
+	std::cerr << "Elapsed: " << elapsed_s << " s\n";
+	std::cerr << "Throughput: " << throughput << " MiB/s\n";
+	return 0;
+}
+
+// `limits` is non-null for --set-throttle: its current settings are sent to the daemon.
+static int run_client_mode(const fs::path &socket_path, const std::vector<fs::path> &paths, bool uppercase_hex, const std::string &verify_hex, bool stop, const hashcore::Throttle *limits) {
+	hashcore::Request request;
+	if (stop) {
+		request.opcode = hashcore::Opcode::Shutdown;
+	} else if (limits) {
+		request.opcode = hashcore::Opcode::SetThrottle;
+		request.bytes_per_second = limits->bytes_per_second();
+		request.max_iops = limits->max_iops();
+		request.background = limits->background();
+	} else if (!verify_hex.empty()) {
+		if (paths.size() != 1 || !hashcore::from_hex(verify_hex, request.expected)) {
+			std::cerr << "Error: --verify needs one file and a 64-digit hex digest\n";
+			return 1;
+		}
+		request.opcode = hashcore::Opcode::Verify;
+	} else {
+		request.opcode = paths.size() == 1 ? hashcore::Opcode::Hash : hashcore::Opcode::Batch;
+	}
+	// The daemon has its own working directory, so always send absolute paths.
+	for (const auto &path : paths) {
+		std::error_code ec;
+		fs::path absolute = fs::absolute(path, ec);
+		request.paths.push_back((ec ? path : absolute).u8string());
+	}
+
+	hashcore::DaemonClient client;
+	hashcore::Response response;
+	std::string error;
+	if (!client.connect(socket_path, error) || !client.call(request, response, error)) {
+		std::cerr << "Error: " << error << "\n";
+		return 3;
+	}
+
+	if (limits) {
+		if (response.results.empty() || response.results[0].status != hashcore::ResultStatus::Ok) {
+			std::cerr << "Error: " << (response.results.empty() ? std::string("No reply") : response.results[0].message) << "\n";
+			return 3;
+		}
+		return 0;
+	}
+
+	int exit_code = 0;
+	uint64_t cache_hits = 0;
+	for (size_t i = 0; i < response.results.size() && i < request.paths.size(); ++i) {
+		const auto &result = response.results[i];
+		if (result.status == hashcore::ResultStatus::Error) {
+			std::cerr << "Error: " << result.message << ": " << request.paths[i] << "\n";
+			exit_code = 3;
+			continue;
+		}
+		if (result.flags & hashcore::kResultFromCache) {
+			++cache_hits;
+		}
+		std::cout << hashcore::to_hex(result.digest, uppercase_hex) << "  " << request.paths[i] << "\n";
+		if (result.status == hashcore::ResultStatus::Mismatch) {
+			std::cerr << "Mismatch: expected " << verify_hex << "\n";
+			exit_code = 4;
+		}
+	}
+	if (!stop) {
+		std::cerr << "Files: " << response.results.size() << " (" << cache_hits << " from cache)\n";
+	}
+	return exit_code;
+}
+
+// Strict numeric parsing: the whole argument must be a number in range.
+static bool parse_unsigned(const wchar_t *text, unsigned long max_value, unsigned long &out_value) {
+	if (!*text || *text == L'-' || *text == L'+' || std::iswspace(*text)) {
+		return false;
+	}
+	wchar_t *end = nullptr;
+	errno = 0;
+	unsigned long value = std::wcstoul(text, &end, 10);
+	if (*end != L'\0' || errno == ERANGE || value > max_value) {
+		return false;
+	}
+	out_value = value;
+	return true;
+}
+
+// --rate in MiB/s: 0 (unlimited) or between 1 byte/s and 1 TiB/s, so the byte rate fits in uint64_t.
+static bool parse_rate(const wchar_t *text, double &out_mib) {
+	const double kMaxRateMib = 1024.0 * 1024.0;
+	if (!*text || std::iswspace(*text)) {
+		return false;
+	}
+	wchar_t *end = nullptr;
+	errno = 0;
+	double value = std::wcstod(text, &end);
+	if (*end != L'\0' || errno == ERANGE || !std::isfinite(value) || value < 0.0 || value > kMaxRateMib) {
+		return false;
+	}
+	if (value > 0.0 && value * 1024.0 * 1024.0 < 1.0) {
+		return false;  // would round down to 0 bytes/s, i.e. unlimited
+	}
+	out_mib = value;
+	return true;
+}
+
+static bool takes_value(const wchar_t *option) {
+	static const wchar_t *const kValueOptions[] = {
+		L"--rate", L"--iops", L"--socket", L"--workers", L"--cache", L"--snapshot",
+		L"--baseline", L"--settle", L"--node", L"--verify"};
+	for (const wchar_t *name : kValueOptions) {
+		if (std::wcscmp(option, name) == 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static int usage_error(const std::string &message) {
+	std::cerr << "Error: " << message << " (run without arguments for usage)\n";
+	return 1;
 }
 
 int wmain(int argc, wchar_t **argv) {
@@ -25,17 +313,221 @@ int wmain(int argc, wchar_t **argv) {
 	}
 
 	bool uppercase_hex = false;
+	double rate_mib = 0.0;
+	unsigned long max_iops = 0;
+	bool background = false;
+	bool tar_mode = false;
+	bool daemon_mode = false;
+	bool client_mode = false;
+	bool stop_daemon = false;
+	bool set_throttle = false;
+	fs::path socket_path;
+	std::string verify_hex;
+	unsigned long worker_count = 0;
+	bool workers_given = false;
+	unsigned long cache_capacity = 65536;
+	bool cache_given = false;
+	fs::path snapshot_path;
+	fs::path baseline_path;
+	bool trust_directory_mtime = false;
+	bool watch_mode = false;
+	unsigned long settle_ms = 250;
+	bool settle_given = false;
+	bool bench_mode = false;
+	bool pin_workers = false;
+	std::vector<std::wstring> node_routes;
 	int argi = 1;
-	if (std::wcscmp(argv[argi], L"-u") == 0 || std::wcscmp(argv[argi], L"--uppercase") == 0) {
-		uppercase_hex = true;
-		++argi;
+	for (; argi < argc; ++argi) {
+		const wchar_t *arg = argv[argi];
+		if (arg[0] != L'-') {
+			break;
+		}
+		if (std::wcscmp(arg, L"--") == 0) {
+			++argi;  // everything after "--" is a path, even if it starts with '-'
+			break;
+		}
+		if (takes_value(arg) && argi + 1 >= argc) {
+			return usage_error(fs::path(arg).u8string() + " needs a value");
+		}
+		bool valid = true;
+		if (std::wcscmp(arg, L"-u") == 0 || std::wcscmp(arg, L"--uppercase") == 0) {
+			uppercase_hex = true;
+		} else if (std::wcscmp(arg, L"--tar") == 0) {
+			tar_mode = true;
+		} else if (std::wcscmp(arg, L"--rate") == 0) {
+			valid = parse_rate(argv[++argi], rate_mib);
+		} else if (std::wcscmp(arg, L"--iops") == 0) {
+			valid = parse_unsigned(argv[++argi], UINT32_MAX, max_iops);
+		} else if (std::wcscmp(arg, L"--background") == 0) {
+			background = true;
+		} else if (std::wcscmp(arg, L"--daemon") == 0) {
+			daemon_mode = true;
+		} else if (std::wcscmp(arg, L"--client") == 0) {
+			client_mode = true;
+		} else if (std::wcscmp(arg, L"--stop") == 0) {
+			stop_daemon = true;
+		} else if (std::wcscmp(arg, L"--set-throttle") == 0) {
+			set_throttle = true;
+		} else if (std::wcscmp(arg, L"--socket") == 0) {
+			socket_path = argv[++argi];
+		} else if (std::wcscmp(arg, L"--workers") == 0) {
+			valid = parse_unsigned(argv[++argi], 4096, worker_count);
+			workers_given = true;
+		} else if (std::wcscmp(arg, L"--cache") == 0) {
+			valid = parse_unsigned(argv[++argi], ULONG_MAX, cache_capacity);
+			cache_given = true;
+		} else if (std::wcscmp(arg, L"--snapshot") == 0) {
+			snapshot_path = argv[++argi];
+		} else if (std::wcscmp(arg, L"--baseline") == 0) {
+			baseline_path = argv[++argi];
+		} else if (std::wcscmp(arg, L"--trust-dir-mtime") == 0) {
+			trust_directory_mtime = true;
+		} else if (std::wcscmp(arg, L"--watch") == 0) {
+			watch_mode = true;
+		} else if (std::wcscmp(arg, L"--settle") == 0) {
+			valid = parse_unsigned(argv[++argi], 24UL * 60 * 60 * 1000, settle_ms);
+			settle_given = true;
+		} else if (std::wcscmp(arg, L"--bench") == 0) {
+			bench_mode = true;
+		} else if (std::wcscmp(arg, L"--pin") == 0) {
+			pin_workers = true;
+		} else if (std::wcscmp(arg, L"--node") == 0) {
+			node_routes.push_back(argv[++argi]);
+		} else if (std::wcscmp(arg, L"--verify") == 0) {
+			verify_hex = fs::path(argv[++argi]).u8string();
+		} else {
+			return usage_error("Unknown option " + fs::path(arg).u8string());
+		}
+		if (!valid) {
+			return usage_error("Invalid value for " + fs::path(arg).u8string() + ": " + fs::path(argv[argi]).u8string());
+		}
 	}
-	if (argi >= argc) {
-		print_usage();
-		return 1;
+	size_t positional = static_cast<size_t>(argc - argi);
+
+	// Exactly one mode; options that only some modes read are rejected elsewhere.
+	bool snapshot_mode = !snapshot_path.empty();
+	int modes = tar_mode + daemon_mode + client_mode + snapshot_mode + watch_mode + bench_mode;
+	if (modes > 1) {
+		return usage_error("--tar, --daemon, --client, --snapshot, --watch and --bench are mutually exclusive");
+	}
+	bool throttle_given = rate_mib > 0.0 || max_iops > 0 || background;
+	if (set_throttle && !client_mode) {
+		return usage_error("--set-throttle applies only to --client");
+	}
+	if (client_mode && throttle_given && !set_throttle) {
+		return usage_error("Throttle options with --client need --set-throttle");
+	}
+	bool pool_mode = daemon_mode || watch_mode || bench_mode || snapshot_mode;
+	if ((pin_workers || !node_routes.empty()) && !pool_mode) {
+		return usage_error("--pin and --node apply only to --daemon, --watch, --bench and --snapshot");
+	}
+	if (!node_routes.empty() && !pin_workers) {
+		return usage_error("--node requires --pin");
+	}
+	if (workers_given && !pool_mode) {
+		return usage_error("--workers applies only to --daemon, --watch, --bench and --snapshot");
+	}
+	if (cache_given && !daemon_mode) {
+		return usage_error("--cache applies only to --daemon");
+	}
+	if (!socket_path.empty() && !daemon_mode && !client_mode) {
+		return usage_error("--socket applies only to --daemon and --client");
+	}
+	if ((stop_daemon || !verify_hex.empty()) && !client_mode) {
+		return usage_error("--stop and --verify apply only to --client");
+	}
+	if (stop_daemon + set_throttle + !verify_hex.empty() > 1) {
+		return usage_error("--stop, --set-throttle and --verify are mutually exclusive");
+	}
+	if ((!baseline_path.empty() || trust_directory_mtime) && !snapshot_mode) {
+		return usage_error("--baseline and --trust-dir-mtime apply only to --snapshot");
+	}
+	if (settle_given && !watch_mode) {
+		return usage_error("--settle applies only to --watch");
+	}
+	if (daemon_mode || stop_daemon || set_throttle) {
+		if (positional > 0) {
+			return usage_error("Unexpected argument " + fs::path(argv[argi]).u8string());
+		}
+	} else if (client_mode || bench_mode) {
+		if (positional == 0) {
+			print_usage();
+			return 1;
+		}
+	} else if (positional != 1) {
+		if (positional == 0) {
+			print_usage();
+			return 1;
+		}
+		return usage_error("Unexpected argument " + fs::path(argv[argi + 1]).u8string());
+	}
+
+	uint64_t rate_bytes = rate_mib > 0.0 ? static_cast<uint64_t>(rate_mib * 1024.0 * 1024.0) : 0;
+	hashcore::Throttle throttle(rate_bytes, static_cast<uint32_t>(max_iops), background);
+	bool throttled = rate_bytes > 0 || max_iops > 0 || background;
+
+	hashcore::ServiceOptions service;
+	service.worker_count = static_cast<unsigned>(worker_count);
+	service.cache_capacity = cache_capacity;
+	service.throttle = throttled ? &throttle : nullptr;
+	service.pin_workers = pin_workers;
+	if (!node_routes.empty()) {
+		hashcore::CpuTopology topology;
+		std::string error;
+		if (!hashcore::query_cpu_topology(topology, error)) {
+			std::cerr << "Error: " << error << "\n";
+			return 3;
+		}
+		for (const auto &route : node_routes) {
+			size_t separator = route.rfind(L'=');
+			unsigned long node = 0;
+			if (separator == std::wstring::npos || separator == 0 || !parse_unsigned(route.c_str() + separator + 1, UINT32_MAX, node)) {
+				return usage_error("--node expects <volume path>=<node number>, got " + fs::path(route).u8string());
+			}
+			if (topology.node_index(static_cast<uint32_t>(node)) == hashcore::kAnyNode) {
+				std::string available;
+				for (uint32_t number : topology.node_numbers) {
+					available += (available.empty() ? "" : ", ") + std::to_string(number);
+				}
+				return usage_error("NUMA node " + std::to_string(node) + " has no processors (available: " + available + ")");
+			}
+			uint64_t volume = 0;
+			if (!hashcore::query_volume_serial(route.substr(0, separator), volume, error)) {
+				return usage_error(error + ": " + fs::path(route.substr(0, separator)).u8string());
+			}
+			service.volume_nodes[volume] = static_cast<uint32_t>(node);
+		}
+	}
+
+	if (daemon_mode) {
+		hashcore::DaemonOptions options;
+		options.socket_path = socket_path;
+		options.service = service;
+		// Always attach the throttle so --set-throttle can impose limits later.
+		options.service.throttle = &throttle;
+		std::string error;
+		if (!hashcore::run_daemon(options, error)) {
+			std::cerr << "Error: " << error << "\n";
+			return 3;
+		}
+		return 0;
+	}
+	if (client_mode) {
+		std::vector<fs::path> paths(argv + argi, argv + argc);
+		return run_client_mode(socket_path, paths, uppercase_hex, verify_hex, stop_daemon, set_throttle ? &throttle : nullptr);
+	}
+
+	if (bench_mode) {
+		return run_bench_mode(std::vector<fs::path>(argv + argi, argv + argc), uppercase_hex, service);
 	}
 
 	fs::path path = argv[argi];
+	if (snapshot_mode) {
+		return run_snapshot_mode(path, snapshot_path, baseline_path, trust_directory_mtime, uppercase_hex, service);
+	}
+	if (watch_mode) {
+		return run_watch_mode(path, settle_ms, uppercase_hex, service);
+	}
 	if (!fs::exists(path) || !fs::is_regular_file(path)) {
 		std::wcerr << L"File not found: " << path.wstring() << L"\n";
 		return 2;
@@ -45,7 +537,10 @@ int wmain(int argc, wchar_t **argv) {
 	uint64_t size_bytes = 0;
 	double elapsed_s = 0.0;
 	std::string error;
-	if (!hashcore::compute_sha256_streamed(path, digest, size_bytes, elapsed_s, error)) {
+	if (tar_mode) {
+		return run_tar_mode(path, uppercase_hex, throttled ? &throttle : nullptr);
+	}
+	if (!hashcore::compute_sha256_streamed_throttled(path, digest, size_bytes, elapsed_s, error, throttled ? &throttle : nullptr, nullptr, nullptr, nullptr)) {
 		std::cerr << "Error: " << error << "\n";
 		return 3;
 	}
@@ -0,0 +1,122 @@
+// pipeline.hpp - read-ahead thread that decouples a source policy from its consumer
+#pragma once
+
+#include "hash.hpp"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace hashcore {
+
+// Runs source.read() (I/O, throttling, decompression) on its own thread into a small
+// ring of buffers, handing filled chunks to the consumer without copying.
+// The source must already be open. Chunks stay valid until the next call to next().
+template <class Source>
+class ChunkPipeline {
+public:
+	explicit ChunkPipeline(Source &source, size_t chunk_size = HASH_BUFFER_SIZE, size_t depth = 3)
+		: source_(source), slots_(depth) {
+		for (Slot &slot : slots_) {
+			slot.buffer.resize(chunk_size);
+			free_.push_back(&slot);
+		}
+	}
+	ChunkPipeline(const ChunkPipeline &) = delete;
+	ChunkPipeline &operator=(const ChunkPipeline &) = delete;
+	~ChunkPipeline() { stop(); }
+
+	void start() {
+		producer_ = std::thread([this]() { run(); });
+	}
+
+	// Blocks for the next chunk. length == 0 means end of stream.
+	// Returns false if the source failed (out_error holds its message).
+	bool next(const unsigned char *&data, size_t &length, std::string &out_error) {
+		std::unique_lock<std::mutex> lock(mutex_);
+		if (current_) {
+			free_.push_back(current_);
+			current_ = nullptr;
+			cv_.notify_all();
+		}
+		cv_.wait(lock, [this]() { return !filled_.empty() || failed_; });
+		if (filled_.empty()) {
+			out_error = error_;
+			return false;
+		}
+		current_ = filled_.front();
+		filled_.pop_front();
+		data = current_->buffer.data();
+		length = current_->length;
+		return true;
+	}
+
+	// Ask the producer to finish its current read and exit. Safe to call more than once.
+	void stop() {
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			stopping_ = true;
+		}
+		cv_.notify_all();
+		if (producer_.joinable()) {
+			producer_.join();
+		}
+	}
+
+private:
+	struct Slot {
+		std::vector<unsigned char> buffer;
+		size_t length = 0;
+	};
+
+	void run() {
+		for (;;) {
+			Slot *slot = nullptr;
+			{
+				std::unique_lock<std::mutex> lock(mutex_);
+				cv_.wait(lock, [this]() { return !free_.empty() || stopping_; });
+				if (stopping_) {
+					return;
+				}
+				slot = free_.front();
+				free_.pop_front();
+			}
+			std::string error;
+			size_t bytes_read = 0;
+			bool ok = source_.read(slot->buffer.data(), slot->buffer.size(), bytes_read, error);
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				if (!ok) {
+					error_ = error;
+					failed_ = true;
+				} else {
+					slot->length = bytes_read;
+					filled_.push_back(slot);
+				}
+			}
+			cv_.notify_all();
+			if (!ok || bytes_read == 0) {
+				return;
+			}
+		}
+	}
+
+	Source &source_;
+	std::vector<Slot> slots_;
+	std::deque<Slot *> free_;
+	std::deque<Slot *> filled_;
+	Slot *current_ = nullptr;
+
+	std::mutex mutex_;
+	std::condition_variable cv_;
+	std::thread producer_;
+	std::string error_;
+	bool failed_ = false;
+	bool stopping_ = false;
+};
+
+}
@@ -0,0 +1,635 @@
+#include "snapshot.hpp"
+#include "hash_win32.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <future>
+#include <iterator>
+#include <list>
+
+namespace hashcore {
+
+namespace {
+
+// Bound the number of outstanding hash futures so a first full scan of a huge tree
+// does not hold one future per file in memory.
+constexpr size_t kMaxPendingHashes = 4096;
+
+struct DirectoryEntry {
+	std::string name;
+	bool directory = false;
+	uint64_t size_bytes = 0;
+	uint64_t last_write_time = 0;
+};
+
+uint64_t filetime_ticks(const FILETIME &time) {
+	return (static_cast<uint64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime;
+}
+
+// List one directory in a single pass; the listing already carries size and timestamps,
+// so unchanged files never need to be opened. Directory reparse points and symlinks are
+// skipped to avoid cycles; other reparse-point files (dedup, cloud placeholders) are hashed.
+bool list_directory(const fs::path &directory, std::vector<DirectoryEntry> &out_entries, std::string &out_error) {
+	out_entries.clear();
+	WIN32_FIND_DATAW data{};
+	HANDLE find = FindFirstFileExW((directory / L"*").wstring().c_str(), FindExInfoBasic, &data, FindExSearchNameMatch, nullptr, FIND_FIRST_EX_LARGE_FETCH);
+	if (find == INVALID_HANDLE_VALUE) {
+		out_error = "Failed to list directory";
+		return false;
+	}
+	do {
+		if (std::wcscmp(data.cFileName, L".") == 0 || std::wcscmp(data.cFileName, L"..") == 0) {
+			continue;
+		}
+		if (data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) {
+			bool link = data.dwReserved0 == IO_REPARSE_TAG_SYMLINK || data.dwReserved0 == IO_REPARSE_TAG_MOUNT_POINT;
+			if (link || (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
+				continue;
+			}
+		}
+		DirectoryEntry entry;
+		entry.name = fs::path(data.cFileName).u8string();
+		entry.directory = (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+		entry.size_bytes = entry.directory ? 0 : (static_cast<uint64_t>(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+		entry.last_write_time = filetime_ticks(data.ftLastWriteTime);
+		out_entries.push_back(std::move(entry));
+	} while (FindNextFileW(find, &data));
+	DWORD last_error = GetLastError();
+	FindClose(find);
+	if (last_error != ERROR_NO_MORE_FILES) {
+		out_error = "Failed to list directory";
+		return false;
+	}
+	std::sort(out_entries.begin(), out_entries.end(), [](const DirectoryEntry &a, const DirectoryEntry &b) { return a.name < b.name; });
+	return true;
+}
+
+std::string join_relative(const std::string &parent, const std::string &name) {
+	return parent.empty() ? name : parent + "/" + name;
+}
+
+// Scans the tree depth-first with an explicit stack and streams the snapshot to disk.
+// Each directory's child block is reserved when the directory is listed and written once
+// every child digest is known, so memory holds only the open directories on the current
+// path plus directories still waiting for file hashes, never the whole tree.
+class TreeScanner {
+public:
+	TreeScanner(const fs::path &root, const SnapshotView *baseline, const SnapshotOptions &options,
+		std::vector<SnapshotChange> &changes, SnapshotStats &stats)
+		: root_(root), baseline_(baseline), options_(options), service_(options.service), changes_(changes), stats_(stats) {}
+
+	~TreeScanner() {
+		discard();
+	}
+
+	// Scan and write the snapshot to a temporary file next to output_path.
+	bool run(const fs::path &output_path, std::string &out_error) {
+		WIN32_FILE_ATTRIBUTE_DATA root_info{};
+		if (!GetFileAttributesExW(root_.wstring().c_str(), GetFileExInfoStandard, &root_info) || !(root_info.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
+			out_error = "Root is not a directory";
+			return false;
+		}
+		if (!directory_digest_.init(out_error)) {
+			return false;
+		}
+		temp_path_ = output_path;
+		temp_path_ += L".tmp";
+		names_path_ = output_path;
+		names_path_ += L".names.tmp";
+		nodes_out_.open(temp_path_, std::ios::binary | std::ios::trunc);
+		names_out_.open(names_path_, std::ios::binary | std::ios::trunc);
+		if (!nodes_out_ || !names_out_) {
+			out_error = "Failed to create snapshot file";
+			return false;
+		}
+
+		root_node_.flags = kNodeDirectory;
+		root_node_.last_write_time = filetime_ticks(root_info.ftLastWriteTime);
+		std::vector<DirectoryEntry> entries;
+		if (!list_directory(root_, entries, out_error)) {
+			return false;
+		}
+		++stats_.directories_listed;
+		uint32_t baseline_root = baseline_ ? 0 : SnapshotView::kNoNode;
+		stack_.push_back(open_directory(nullptr, 0, root_, std::string(), baseline_root, baseline_ != nullptr, std::move(entries)));
+
+		while (!stack_.empty() && error_.empty()) {
+			Frame *frame = stack_.back();
+			if (frame->next == frame->entries.size()) {
+				stack_.pop_back();
+				release(frame);
+				continue;
+			}
+			size_t index = frame->next++;
+			if (frame->entries[index].directory) {
+				if (Frame *child = visit_directory(frame, index)) {
+					++frame->outstanding;
+					stack_.push_back(child);
+				}
+			}
+		}
+		while (!pending_.empty() && error_.empty()) {
+			resolve_front();
+		}
+		if (!error_.empty()) {
+			out_error = error_;
+			return false;
+		}
+		std::memcpy(stats_.root_digest.bytes.data(), root_node_.digest, 32);
+		return finish_file(out_error);
+	}
+
+	// Replace output_path with the file written by run().
+	bool commit(const fs::path &output_path, std::string &out_error) {
+		std::error_code ec;
+		fs::rename(temp_path_, output_path, ec);
+		if (ec) {
+			out_error = "Failed to replace snapshot file";
+			return false;
+		}
+		temp_path_.clear();
+		return true;
+	}
+
+private:
+	// A listed directory whose child block has not been written yet.
+	struct Frame {
+		Frame *parent = nullptr;
+		uint32_t slot = 0;  // index of this directory in parent->children
+		fs::path path;
+		std::string relative;
+		std::vector<DirectoryEntry> entries;
+		std::vector<SnapshotNode> children;
+		std::vector<uint32_t> child_baseline;  // matched baseline node per child, or kNoNode
+		std::vector<bool> child_report;        // report changes beneath this child
+		uint32_t first_child = 0;
+		size_t next = 0;  // next child the traversal looks at
+		// Traversal token + unresolved file hashes + unfinished child directories.
+		size_t outstanding = 1;
+		std::list<Frame>::iterator self;
+	};
+
+	struct PendingHash {
+		Frame *frame = nullptr;
+		uint32_t slot = 0;
+		std::shared_future<FileHashResult> future;
+		bool compare = false;  // report Modified if the digest differs from previous_digest
+		Sha256Digest previous_digest{};
+		std::string relative_path;
+	};
+
+	SnapshotNode &node_of(Frame *parent, uint32_t slot) {
+		return parent ? parent->children[slot] : root_node_;
+	}
+
+	Frame *open_directory(Frame *parent, uint32_t slot, const fs::path &path, const std::string &relative,
+		uint32_t baseline_index, bool report_changes, std::vector<DirectoryEntry> entries) {
+		frames_.emplace_back();
+		Frame *frame = &frames_.back();
+		frame->self = std::prev(frames_.end());
+		frame->parent = parent;
+		frame->slot = slot;
+		frame->path = path;
+		frame->relative = relative;
+		frame->entries = std::move(entries);
+
+		if (frame->entries.size() >= SnapshotView::kNoNode - next_node_) {
+			error_ = "Too many entries for the snapshot format";
+			return frame;
+		}
+		frame->first_child = next_node_;
+		next_node_ += static_cast<uint32_t>(frame->entries.size());
+		SnapshotNode &self = node_of(parent, slot);
+		self.first_child = frame->first_child;
+		self.child_count = static_cast<uint32_t>(frame->entries.size());
+
+		frame->children.resize(frame->entries.size());
+		frame->child_baseline.assign(frame->entries.size(), SnapshotView::kNoNode);
+		frame->child_report.assign(frame->entries.size(), false);
+		for (size_t i = 0; i < frame->entries.size(); ++i) {
+			const DirectoryEntry &entry = frame->entries[i];
+			SnapshotNode &child = frame->children[i];
+			child.flags = entry.directory ? kNodeDirectory : 0;
+			child.size_bytes = entry.size_bytes;
+			child.last_write_time = entry.last_write_time;
+			child.name_offset = names_size_;
+			child.name_length = static_cast<uint32_t>(entry.name.size());
+			names_out_.write(entry.name.data(), static_cast<std::streamsize>(entry.name.size()));
+			names_size_ += entry.name.size();
+		}
+
+		// Merge the sorted new listing with the sorted baseline children.
+		uint32_t old_index = 0, old_end = 0;
+		if (baseline_index != SnapshotView::kNoNode) {
+			const SnapshotNode &old_directory = baseline_->node(baseline_index);
+			old_index = old_directory.first_child;
+			old_end = old_directory.first_child + old_directory.child_count;
+		}
+		size_t new_index = 0;
+		while (new_index < frame->entries.size() || old_index < old_end) {
+			int order = 0;
+			if (new_index == frame->entries.size()) {
+				order = 1;
+			} else if (old_index == old_end) {
+				order = -1;
+			} else {
+				std::string_view old_name = baseline_->name(baseline_->node(old_index));
+				order = std::string_view(frame->entries[new_index].name).compare(old_name);
+			}
+
+			if (order > 0) {
+				const SnapshotNode &removed = baseline_->node(old_index);
+				if (report_changes) {
+					report(ChangeKind::Removed, (removed.flags & kNodeDirectory) != 0, join_relative(relative, std::string(baseline_->name(removed))));
+				}
+				++old_index;
+				continue;
+			}
+
+			const DirectoryEntry &entry = frame->entries[new_index];
+			uint32_t matched = SnapshotView::kNoNode;
+			if (order == 0) {
+				const SnapshotNode &previous = baseline_->node(old_index);
+				if (((previous.flags & kNodeDirectory) != 0) == entry.directory) {
+					matched = old_index;
+				} else if (report_changes) {
+					report(ChangeKind::Removed, !entry.directory, join_relative(relative, entry.name));
+				}
+				++old_index;
+			}
+			if (matched == SnapshotView::kNoNode && report_changes) {
+				report(ChangeKind::Added, entry.directory, join_relative(relative, entry.name));
+			}
+			frame->child_baseline[new_index] = matched;
+			frame->child_report[new_index] = report_changes && matched != SnapshotView::kNoNode;
+			if (!entry.directory) {
+				visit_file(frame, static_cast<uint32_t>(new_index));
+			}
+			++new_index;
+		}
+		return frame;
+	}
+
+	// Returns the opened child directory, or nullptr if it could not be listed (it then
+	// keeps the kNodeUnreadable flag and a zero digest).
+	Frame *visit_directory(Frame *frame, size_t index) {
+		const DirectoryEntry &entry = frame->entries[index];
+		uint32_t slot = static_cast<uint32_t>(index);
+		uint32_t baseline_index = frame->child_baseline[index];
+		fs::path path = frame->path / fs::u8path(entry.name);
+		std::string relative = join_relative(frame->relative, entry.name);
+
+		std::vector<DirectoryEntry> entries;
+		std::string error;
+		if (baseline_index != SnapshotView::kNoNode && options_.trust_directory_mtime
+			&& baseline_->node(baseline_index).last_write_time == entry.last_write_time
+			&& !(baseline_->node(baseline_index).flags & kNodeUnreadable)
+			&& reuse_baseline_listing(path, baseline_index, entries)) {
+			++stats_.directories_reused;
+		} else if (list_directory(path, entries, error)) {
+			++stats_.directories_listed;
+		} else {
+			frame->children[index].flags |= kNodeUnreadable;
+			report(ChangeKind::Error, true, relative, error);
+			return nullptr;
+		}
+		return open_directory(frame, slot, path, relative, baseline_index, frame->child_report[index], std::move(entries));
+	}
+
+	// An unchanged directory timestamp only vouches for the directory's own entries, so the
+	// baseline supplies the child list but each child directory's timestamp is read afresh;
+	// the scan then descends into every child directory and checks it the same way.
+	// Returns false (list normally) if a child directory can no longer be queried.
+	bool reuse_baseline_listing(const fs::path &path, uint32_t baseline_index, std::vector<DirectoryEntry> &out_entries) {
+		out_entries.clear();
+		const SnapshotNode &previous = baseline_->node(baseline_index);
+		for (uint32_t i = 0; i < previous.child_count; ++i) {
+			const SnapshotNode &old_child = baseline_->node(previous.first_child + i);
+			DirectoryEntry entry;
+			entry.name = std::string(baseline_->name(old_child));
+			entry.directory = (old_child.flags & kNodeDirectory) != 0;
+			entry.size_bytes = entry.directory ? 0 : old_child.size_bytes;
+			entry.last_write_time = old_child.last_write_time;
+			if (entry.directory) {
+				WIN32_FILE_ATTRIBUTE_DATA info{};
+				if (!GetFileAttributesExW((path / fs::u8path(entry.name)).wstring().c_str(), GetFileExInfoStandard, &info)
+					|| !(info.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
+					return false;
+				}
+				entry.last_write_time = filetime_ticks(info.ftLastWriteTime);
+			}
+			out_entries.push_back(std::move(entry));
+		}
+		return true;
+	}
+
+	void visit_file(Frame *frame, uint32_t slot) {
+		SnapshotNode &node = frame->children[slot];
+		uint32_t baseline_index = frame->child_baseline[slot];
+		if (baseline_index != SnapshotView::kNoNode) {
+			const SnapshotNode &previous = baseline_->node(baseline_index);
+			if (previous.size_bytes == node.size_bytes && previous.last_write_time == node.last_write_time && !(previous.flags & kNodeUnreadable)) {
+				std::memcpy(node.digest, previous.digest, sizeof(node.digest));
+				++stats_.files_reused;
+				return;
+			}
+		}
+		const DirectoryEntry &entry = frame->entries[slot];
+		PendingHash pending;
+		pending.frame = frame;
+		pending.slot = slot;
+		pending.future = service_.submit(frame->path / fs::u8path(entry.name));
+		pending.relative_path = join_relative(frame->relative, entry.name);
+		if (baseline_index != SnapshotView::kNoNode && frame->child_report[slot]) {
+			pending.compare = true;
+			std::memcpy(pending.previous_digest.bytes.data(), baseline_->node(baseline_index).digest, 32);
+		}
+		++frame->outstanding;
+		pending_.push_back(std::move(pending));
+		if (pending_.size() > kMaxPendingHashes) {
+			resolve_front();
+		}
+	}
+
+	void resolve_front() {
+		PendingHash pending = std::move(pending_.front());
+		pending_.pop_front();
+		FileHashResult result = pending.future.get();
+		SnapshotNode &node = pending.frame->children[pending.slot];
+		if (!result.success) {
+			node.flags |= kNodeUnreadable;
+			std::memset(node.digest, 0, sizeof(node.digest));
+			report(ChangeKind::Error, false, pending.relative_path, result.error);
+		} else {
+			++stats_.files_hashed;
+			stats_.bytes_hashed += result.size_bytes;
+			node.size_bytes = result.size_bytes;
+			std::memcpy(node.digest, result.digest.bytes.data(), sizeof(node.digest));
+			if (pending.compare && pending.previous_digest.bytes != result.digest.bytes) {
+				report(ChangeKind::Modified, false, pending.relative_path);
+			}
+		}
+		release(pending.frame);
+	}
+
+	// Drop one outstanding reference; directories that become complete are finished
+	// bottom-up, each handing its digest to its parent.
+	void release(Frame *frame) {
+		while (frame && --frame->outstanding == 0) {
+			Frame *parent = frame->parent;
+			finish_directory(*frame);
+			frames_.erase(frame->self);
+			frame = parent;
+		}
+	}
+
+	void finish_directory(Frame &frame) {
+		uint64_t total = 0;
+		for (size_t i = 0; i < frame.children.size(); ++i) {
+			const SnapshotNode &child = frame.children[i];
+			const std::string &name = frame.entries[i].name;
+			unsigned char prefix[5];
+			prefix[0] = (child.flags & kNodeDirectory) ? 'd' : 'f';
+			for (int b = 0; b < 4; ++b) {
+				prefix[1 + b] = static_cast<unsigned char>(child.name_length >> (8 * b));
+			}
+			if (!directory_digest_.update(prefix, sizeof(prefix), error_)
+				|| !directory_digest_.update(reinterpret_cast<const unsigned char *>(name.data()), name.size(), error_)
+				|| !directory_digest_.update(child.digest, sizeof(child.digest), error_)) {
+				return;
+			}
+			total += child.size_bytes;
+		}
+		Sha256Digest result;
+		if (!directory_digest_.finish(result, error_)) {
+			return;
+		}
+		SnapshotNode &self = node_of(frame.parent, frame.slot);
+		std::memcpy(self.digest, result.bytes.data(), sizeof(self.digest));
+		self.size_bytes = total;
+		write_nodes(frame.first_child, frame.children.data(), frame.children.size());
+	}
+
+	void write_nodes(uint32_t first, const SnapshotNode *nodes, size_t count) {
+		if (count == 0) {
+			return;
+		}
+		nodes_out_.seekp(static_cast<std::streamoff>(sizeof(SnapshotHeader) + static_cast<uint64_t>(first) * sizeof(SnapshotNode)));
+		nodes_out_.write(reinterpret_cast<const char *>(nodes), static_cast<std::streamsize>(count * sizeof(SnapshotNode)));
+	}
+
+	// Root node, names section and header go in last, once their sizes are known.
+	bool finish_file(std::string &out_error) {
+		write_nodes(0, &root_node_, 1);
+		names_out_.close();
+
+		SnapshotHeader header{};
+		std::memcpy(header.magic, kSnapshotMagic, sizeof(header.magic));
+		header.version = kSnapshotVersion;
+		header.node_size = sizeof(SnapshotNode);
+		header.node_count = next_node_;
+		header.nodes_offset = sizeof(SnapshotHeader);
+		header.names_offset = header.nodes_offset + static_cast<uint64_t>(next_node_) * sizeof(SnapshotNode);
+		header.names_size = names_size_;
+		FILETIME now{};
+		GetSystemTimeAsFileTime(&now);
+		header.created_time = filetime_ticks(now);
+
+		nodes_out_.seekp(static_cast<std::streamoff>(header.names_offset));
+		std::ifstream names_in(names_path_, std::ios::binary);
+		std::vector<char> chunk(1 << 20);
+		while (names_in) {
+			names_in.read(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+			nodes_out_.write(chunk.data(), names_in.gcount());
+		}
+		names_in.close();
+		nodes_out_.seekp(0);
+		nodes_out_.write(reinterpret_cast<const char *>(&header), sizeof(header));
+		nodes_out_.close();
+		std::error_code ec;
+		fs::remove(names_path_, ec);
+		if (!nodes_out_ || !names_out_) {
+			out_error = "Failed to write snapshot";
+			return false;
+		}
+		return true;
+	}
+
+	void discard() {
+		std::error_code ec;
+		if (nodes_out_.is_open()) {
+			nodes_out_.close();
+		}
+		if (names_out_.is_open()) {
+			names_out_.close();
+		}
+		if (!names_path_.empty()) {
+			fs::remove(names_path_, ec);
+		}
+		if (!temp_path_.empty()) {
+			fs::remove(temp_path_, ec);
+		}
+	}
+
+	void report(ChangeKind kind, bool directory, const std::string &relative, const std::string &message = std::string()) {
+		SnapshotChange change;
+		change.kind = kind;
+		change.directory = directory;
+		change.path = relative;
+		change.message = message;
+		changes_.push_back(std::move(change));
+	}
+
+	fs::path root_;
+	const SnapshotView *baseline_;
+	const SnapshotOptions &options_;
+	HashService service_;
+	std::vector<SnapshotChange> &changes_;
+	SnapshotStats &stats_;
+
+	CngSha256 directory_digest_;
+	std::string error_;
+	SnapshotNode root_node_{};
+	uint32_t next_node_ = 1;  // node 0 is the root
+	uint64_t names_size_ = 0;
+	std::list<Frame> frames_;
+	std::vector<Frame *> stack_;
+	std::deque<PendingHash> pending_;
+
+	fs::path temp_path_;
+	fs::path names_path_;
+	std::ofstream nodes_out_;
+	std::ofstream names_out_;
+};
+
+}
+
+bool SnapshotView::open(const fs::path &snapshot_path, std::string &out_error) {
+	close();
+	HANDLE file = CreateFileW(snapshot_path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		out_error = "Failed to open snapshot";
+		return false;
+	}
+	file_ = file;
+	LARGE_INTEGER size{};
+	if (!GetFileSizeEx(file, &size) || static_cast<uint64_t>(size.QuadPart) < sizeof(SnapshotHeader)) {
+		close();
+		out_error = "Snapshot is truncated";
+		return false;
+	}
+	uint64_t file_size = static_cast<uint64_t>(size.QuadPart);
+	mapping_ = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!mapping_) {
+		close();
+		out_error = "CreateFileMappingW failed";
+		return false;
+	}
+	base_ = static_cast<const unsigned char *>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+	if (!base_) {
+		close();
+		out_error = "MapViewOfFile failed";
+		return false;
+	}
+
+	const SnapshotHeader &head = header();
+	bool valid = std::memcmp(head.magic, kSnapshotMagic, sizeof(head.magic)) == 0
+		&& head.version == kSnapshotVersion
+		&& head.node_size == sizeof(SnapshotNode)
+		&& head.node_count >= 1 && head.node_count < SnapshotView::kNoNode
+		&& head.nodes_offset == sizeof(SnapshotHeader)
+		&& head.names_offset == head.nodes_offset + head.node_count * sizeof(SnapshotNode)
+		&& head.names_offset <= file_size
+		&& head.names_size <= file_size - head.names_offset;
+	if (!valid) {
+		close();
+		out_error = "Not a valid snapshot file";
+		return false;
+	}
+	nodes_ = reinterpret_cast<const SnapshotNode *>(base_ + head.nodes_offset);
+	names_ = reinterpret_cast<const char *>(base_ + head.names_offset);
+
+	// Bounds-check every node once so lookups can trust the mapping afterwards.
+	for (uint64_t i = 0; i < head.node_count; ++i) {
+		const SnapshotNode &entry = nodes_[i];
+		bool directory = (entry.flags & kNodeDirectory) != 0;
+		if (entry.name_offset > head.names_size || entry.name_length > head.names_size - entry.name_offset
+			|| (!directory && entry.child_count != 0)
+			|| (directory && entry.child_count != 0 && (entry.first_child <= i || static_cast<uint64_t>(entry.first_child) + entry.child_count > head.node_count))) {
+			close();
+			out_error = "Snapshot is corrupt";
+			return false;
+		}
+	}
+	if (!(nodes_[0].flags & kNodeDirectory)) {
+		close();
+		out_error = "Snapshot is corrupt";
+		return false;
+	}
+	return true;
+}
+
+void SnapshotView::close() {
+	if (base_) {
+		UnmapViewOfFile(base_);
+	}
+	if (mapping_) {
+		CloseHandle(mapping_);
+	}
+	if (file_) {
+		CloseHandle(file_);
+	}
+	base_ = nullptr;
+	mapping_ = nullptr;
+	file_ = nullptr;
+	nodes_ = nullptr;
+	names_ = nullptr;
+}
+
+uint32_t SnapshotView::find_child(const SnapshotNode &directory, std::string_view child_name) const {
+	uint32_t low = directory.first_child;
+	uint32_t high = directory.first_child + directory.child_count;
+	while (low < high) {
+		uint32_t mid = low + (high - low) / 2;
+		int order = name(nodes_[mid]).compare(child_name);
+		if (order == 0) {
+			return mid;
+		}
+		if (order < 0) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+	return kNoNode;
+}
+
+bool update_snapshot(const fs::path &root,
+	const fs::path &baseline_path,
+	const fs::path &output_path,
+	const SnapshotOptions &options,
+	std::vector<SnapshotChange> &out_changes,
+	SnapshotStats &out_stats,
+	std::string &out_error) {
+	out_changes.clear();
+	out_stats = SnapshotStats{};
+
+	SnapshotView baseline;
+	if (!baseline_path.empty() && !baseline.open(baseline_path, out_error)) {
+		return false;
+	}
+
+	SnapshotOptions scan_options = options;
+	// Digests are reused through the baseline, not through the service's in-memory cache.
+	scan_options.service.cache_capacity = 0;
+	TreeScanner scanner(root, baseline.is_open() ? &baseline : nullptr, scan_options, out_changes, out_stats);
+	if (!scanner.run(output_path, out_error)) {
+		return false;
+	}
+	baseline.close();
+	return scanner.commit(output_path, out_error);
+}
+
+}
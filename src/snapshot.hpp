@@ -0,0 +1,136 @@
+// snapshot.hpp - Merkle tree snapshots of a directory for incremental re-verification
+#pragma once
+
+#include "hash.hpp"
+#include "hash_service.hpp"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace hashcore {
+
+// On-disk layout (native little-endian, designed to be memory-mapped):
+//   SnapshotHeader
+//   SnapshotNode[node_count]   node 0 is the root directory
+//   char names[names_size]     UTF-8 names, not NUL-terminated
+// A directory's children are contiguous at [first_child, first_child + child_count) and
+// sorted by name (byte order), so lookups are a binary search inside the mapping.
+//
+// File digest = SHA-256 of the contents.
+// Directory digest = SHA-256 over its children in order of
+//   u8 kind ('f' or 'd'), u32 name length, name bytes, u8[32] child digest
+
+constexpr char kSnapshotMagic[8] = {'C', 'H', 'S', 'N', 'A', 'P', '\0', '\x01'};
+constexpr uint32_t kSnapshotVersion = 1;
+
+struct SnapshotHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t node_size;
+	uint64_t node_count;
+	uint64_t nodes_offset;
+	uint64_t names_offset;
+	uint64_t names_size;
+	uint64_t created_time;  // FILETIME ticks
+	uint64_t reserved;
+};
+
+// Node flag bits.
+constexpr uint32_t kNodeDirectory = 0x01;
+constexpr uint32_t kNodeUnreadable = 0x02;  // could not be hashed/listed; digest is zero
+
+struct SnapshotNode {
+	uint64_t size_bytes;       // files: size; directories: total bytes in the subtree
+	uint64_t last_write_time;  // FILETIME ticks
+	uint64_t name_offset;
+	uint32_t name_length;
+	uint32_t flags;
+	uint32_t first_child;
+	uint32_t child_count;
+	unsigned char digest[32];
+};
+
+static_assert(sizeof(SnapshotHeader) == 64, "SnapshotHeader layout is part of the file format");
+static_assert(sizeof(SnapshotNode) == 72, "SnapshotNode layout is part of the file format");
+
+// Read-only memory-mapped view of a snapshot file. The file is fully validated on open.
+class SnapshotView {
+public:
+	static constexpr uint32_t kNoNode = 0xFFFFFFFF;
+
+	SnapshotView() = default;
+	SnapshotView(const SnapshotView &) = delete;
+	SnapshotView &operator=(const SnapshotView &) = delete;
+	~SnapshotView() { close(); }
+
+	bool open(const fs::path &snapshot_path, std::string &out_error);
+	void close();
+
+	bool is_open() const { return base_ != nullptr; }
+	uint32_t node_count() const { return static_cast<uint32_t>(header().node_count); }
+	const SnapshotNode &node(uint32_t index) const { return nodes_[index]; }
+	std::string_view name(const SnapshotNode &entry) const {
+		return std::string_view(names_ + entry.name_offset, entry.name_length);
+	}
+	// Binary search a directory's children by name. Returns kNoNode if absent.
+	uint32_t find_child(const SnapshotNode &directory, std::string_view child_name) const;
+
+private:
+	const SnapshotHeader &header() const { return *reinterpret_cast<const SnapshotHeader *>(base_); }
+
+	void *file_ = nullptr;
+	void *mapping_ = nullptr;
+	const unsigned char *base_ = nullptr;
+	const SnapshotNode *nodes_ = nullptr;
+	const char *names_ = nullptr;
+};
+
+enum class ChangeKind : uint8_t {
+	Added,
+	Removed,
+	Modified,
+	Error
+};
+
+struct SnapshotChange {
+	ChangeKind kind = ChangeKind::Modified;
+	bool directory = false;
+	std::string path;     // relative to the scanned root, '/' separated, UTF-8
+	std::string message;  // Error only
+};
+
+struct SnapshotOptions {
+	// Reuse a directory's child list from the baseline instead of listing it when its last-write
+	// time is unchanged. Child directories are still checked (one attribute query each) and
+	// descended into, so only directories whose own entries changed are listed. Only sound when
+	// files are created or replaced (not rewritten in place), because editing a file does not
+	// touch its parent directory's timestamp.
+	bool trust_directory_mtime = false;
+	ServiceOptions service;  // worker pool and throttle used for rehashing
+};
+
+struct SnapshotStats {
+	uint64_t directories_listed = 0;
+	uint64_t directories_reused = 0;  // child list taken from the baseline (trust_directory_mtime)
+	uint64_t files_hashed = 0;
+	uint64_t files_reused = 0;
+	uint64_t bytes_hashed = 0;
+	Sha256Digest root_digest{};
+};
+
+// Scan `root`, reusing file digests from `baseline_path` (optional) wherever size and
+// last-write time are unchanged, and write a new snapshot to `output_path`.
+// Added/removed/modified entries relative to the baseline are reported in out_changes;
+// unreadable entries are reported as Error and do not abort the scan.
+// output_path may equal baseline_path: the baseline is unmapped before the new file replaces it.
+bool update_snapshot(const fs::path &root,
+	const fs::path &baseline_path,
+	const fs::path &output_path,
+	const SnapshotOptions &options,
+	std::vector<SnapshotChange> &out_changes,
+	SnapshotStats &out_stats,
+	std::string &out_error);
+
+}
@@ -0,0 +1,300 @@
+// tar_stream.hpp - incremental tar parser that digests member data in place
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace hashcore {
+
+template <class Result>
+struct TarMember {
+	std::string name;  // path as stored in the archive (ustar prefix, GNU long name or pax path)
+	uint64_t size_bytes = 0;
+	Result digest{};
+};
+
+// Push-style parser: feed() accepts arbitrary slices of the archive byte stream and digests
+// each regular file's data directly from those slices, without buffering member contents.
+// Understands ustar, GNU long names ('L') and pax extended headers ('x' path/size).
+template <class Digest>
+class TarStreamHasher {
+public:
+	using Member = TarMember<typename Digest::result_type>;
+
+	static constexpr size_t kBlockSize = 512;
+	static constexpr uint64_t kMaxMetadataSize = 1024 * 1024;
+
+	bool init(std::string &out_error) { return digest_.init(out_error); }
+
+	bool feed(const unsigned char *data, size_t length, std::string &out_error) {
+		while (length > 0 && state_ != State::End) {
+			size_t take = 0;
+			switch (state_) {
+			case State::Header:
+				take = std::min(kBlockSize - header_fill_, length);
+				std::memcpy(header_.data() + header_fill_, data, take);
+				header_fill_ += take;
+				if (header_fill_ == kBlockSize) {
+					header_fill_ = 0;
+					if (!parse_header(out_error)) {
+						return false;
+					}
+				}
+				break;
+			case State::Data:
+				take = static_cast<size_t>(std::min<uint64_t>(remaining_, length));
+				if (!digest_.update(data, take, out_error)) {
+					return false;
+				}
+				remaining_ -= take;
+				if (remaining_ == 0 && !complete_member(out_error)) {
+					return false;
+				}
+				break;
+			case State::Metadata:
+				take = static_cast<size_t>(std::min<uint64_t>(remaining_, length));
+				metadata_.append(reinterpret_cast<const char *>(data), take);
+				remaining_ -= take;
+				if (remaining_ == 0) {
+					if (!apply_metadata(out_error)) {
+						return false;
+					}
+					enter_padding(metadata_.size());
+				}
+				break;
+			case State::Skip:
+				take = static_cast<size_t>(std::min<uint64_t>(remaining_, length));
+				remaining_ -= take;
+				if (remaining_ == 0) {
+					enter_padding(entry_size_);
+				}
+				break;
+			case State::Padding:
+				take = static_cast<size_t>(std::min<uint64_t>(remaining_, length));
+				remaining_ -= take;
+				if (remaining_ == 0) {
+					state_ = State::Header;
+				}
+				break;
+			case State::End:
+				break;
+			}
+			data += take;
+			length -= take;
+		}
+		return true;
+	}
+
+	// True once the end-of-archive marker has been seen; further input is ignored.
+	bool done() const { return state_ == State::End; }
+
+	// Validate that the stream ended on an entry boundary.
+	bool finish(std::string &out_error) {
+		if (state_ == State::End || (state_ == State::Header && header_fill_ == 0)) {
+			return true;
+		}
+		out_error = "Truncated tar archive";
+		return false;
+	}
+
+	std::vector<Member> &members() { return members_; }
+
+private:
+	enum class State { Header, Data, Metadata, Skip, Padding, End };
+
+	bool parse_header(std::string &out_error) {
+		if (std::all_of(header_.begin(), header_.end(), [](unsigned char b) { return b == 0; })) {
+			state_ = State::End;
+			return true;
+		}
+
+		uint64_t checksum = 0;
+		for (size_t i = 0; i < kBlockSize; ++i) {
+			checksum += (i >= 148 && i < 156) ? static_cast<unsigned char>(' ') : header_[i];
+		}
+		uint64_t stored_checksum = 0;
+		if (!parse_number(148, 8, stored_checksum) || stored_checksum != checksum) {
+			out_error = "Invalid tar header checksum";
+			return false;
+		}
+
+		uint64_t size = 0;
+		if (!parse_number(124, 12, size)) {
+			out_error = "Invalid tar member size";
+			return false;
+		}
+
+		char type = static_cast<char>(header_[156]);
+		if (type == 'L' || type == 'x') {
+			if (size > kMaxMetadataSize) {
+				out_error = "Oversized tar metadata entry";
+				return false;
+			}
+			metadata_type_ = type;
+			metadata_.clear();
+			begin_entry(State::Metadata, size);
+			return true;
+		}
+		if (type == 'K' || type == 'g') {
+			begin_entry(State::Skip, size);
+			return true;
+		}
+
+		std::string name = pending_name_.empty() ? header_name() : std::move(pending_name_);
+		pending_name_.clear();
+		if (has_pending_size_) {
+			size = pending_size_;
+			has_pending_size_ = false;
+		}
+
+		if (type != '0' && type != '\0' && type != '7') {
+			// Directories, links and devices carry no data we need to digest.
+			begin_entry(State::Skip, size);
+			return true;
+		}
+
+		current_ = Member{};
+		current_.name = std::move(name);
+		current_.size_bytes = size;
+		begin_entry(State::Data, size);
+		if (size == 0) {
+			return complete_member(out_error);
+		}
+		return true;
+	}
+
+	void begin_entry(State state, uint64_t size) {
+		entry_size_ = size;
+		remaining_ = size;
+		state_ = state;
+		if (size == 0) {
+			enter_padding(0);
+		}
+	}
+
+	void enter_padding(uint64_t entry_size) {
+		remaining_ = (kBlockSize - entry_size % kBlockSize) % kBlockSize;
+		state_ = remaining_ > 0 ? State::Padding : State::Header;
+	}
+
+	bool complete_member(std::string &out_error) {
+		if (!digest_.finish(current_.digest, out_error)) {
+			return false;
+		}
+		members_.push_back(std::move(current_));
+		enter_padding(entry_size_);
+		return true;
+	}
+
+	bool apply_metadata(std::string &out_error) {
+		if (metadata_type_ == 'L') {
+			pending_name_ = metadata_.substr(0, metadata_.find('\0'));
+			return true;
+		}
+		// pax records: "<length> <key>=<value>\n"
+		size_t pos = 0;
+		while (pos < metadata_.size() && metadata_[pos] != '\0') {
+			size_t space = metadata_.find(' ', pos);
+			if (space == std::string::npos) {
+				break;
+			}
+			uint64_t record_length = 0;
+			for (size_t i = pos; i < space; ++i) {
+				if (metadata_[i] < '0' || metadata_[i] > '9') {
+					out_error = "Invalid pax header";
+					return false;
+				}
+				record_length = record_length * 10 + static_cast<uint64_t>(metadata_[i] - '0');
+			}
+			if (record_length <= space - pos + 1 || pos + record_length > metadata_.size()) {
+				out_error = "Invalid pax header";
+				return false;
+			}
+			std::string record = metadata_.substr(space + 1, pos + record_length - space - 2);
+			size_t equals = record.find('=');
+			if (equals != std::string::npos) {
+				std::string key = record.substr(0, equals);
+				std::string value = record.substr(equals + 1);
+				if (key == "path") {
+					pending_name_ = value;
+				} else if (key == "size") {
+					pending_size_ = std::strtoull(value.c_str(), nullptr, 10);
+					has_pending_size_ = true;
+				}
+			}
+			pos += static_cast<size_t>(record_length);
+		}
+		return true;
+	}
+
+	// Octal (NUL/space terminated) or GNU base-256 numeric field.
+	bool parse_number(size_t offset, size_t width, uint64_t &out_value) const {
+		const unsigned char *field = header_.data() + offset;
+		out_value = 0;
+		if (field[0] & 0x80) {
+			if (field[0] == 0xFF) {
+				return false;
+			}
+			out_value = field[0] & 0x7F;
+			for (size_t i = 1; i < width; ++i) {
+				if (out_value >> 56) {
+					return false;
+				}
+				out_value = (out_value << 8) | field[i];
+			}
+			return true;
+		}
+		size_t i = 0;
+		while (i < width && field[i] == ' ') {
+			++i;
+		}
+		bool any_digit = false;
+		for (; i < width && field[i] >= '0' && field[i] <= '7'; ++i) {
+			out_value = (out_value << 3) | static_cast<uint64_t>(field[i] - '0');
+			any_digit = true;
+		}
+		return any_digit && (i == width || field[i] == ' ' || field[i] == '\0');
+	}
+
+	std::string header_field(size_t offset, size_t width) const {
+		const char *field = reinterpret_cast<const char *>(header_.data() + offset);
+		return std::string(field, strnlen(field, width));
+	}
+
+	std::string header_name() const {
+		std::string name = header_field(0, 100);
+		// Only POSIX ustar ("ustar\0") has a name prefix; in old GNU headers ("ustar  \0")
+		// those bytes hold atime/ctime and sparse data.
+		if (std::memcmp(header_.data() + 257, "ustar\0", 6) == 0) {
+			std::string prefix = header_field(345, 155);
+			if (!prefix.empty()) {
+				return prefix + "/" + name;
+			}
+		}
+		return name;
+	}
+
+	Digest digest_;
+	State state_ = State::Header;
+	std::array<unsigned char, kBlockSize> header_{};
+	size_t header_fill_ = 0;
+	uint64_t entry_size_ = 0;
+	uint64_t remaining_ = 0;
+
+	char metadata_type_ = 0;
+	std::string metadata_;
+	std::string pending_name_;
+	uint64_t pending_size_ = 0;
+	bool has_pending_size_ = false;
+
+	Member current_;
+	std::vector<Member> members_;
+};
+
+}
@@ -0,0 +1,161 @@
+#include "throttle.hpp"
+#include "hash_engine.hpp"
+#include "hash_win32.hpp"
+
+#include <windows.h>
+#include <algorithm>
+#include <thread>
+
+namespace hashcore {
+
+namespace {
+
+// Never sleep longer than this in one go, so limit changes take effect promptly.
+constexpr std::chrono::milliseconds kMaxThrottleSleep{100};
+
+// Background mode belongs to a thread, so its state is tracked per thread as well.
+thread_local bool t_in_background = false;
+
+}
+
+Throttle::Throttle(uint64_t bytes_per_second, uint32_t max_iops, bool background)
+	: bytes_per_second_(bytes_per_second),
+	  max_iops_(max_iops),
+	  background_(background),
+	  last_refill_(std::chrono::steady_clock::now()) {
+	byte_tokens_ = static_cast<double>(bytes_per_second);
+	op_tokens_ = static_cast<double>(max_iops);
+}
+
+void Throttle::set_bytes_per_second(uint64_t bytes_per_second) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	refill_locked(std::chrono::steady_clock::now());
+	bytes_per_second_.store(bytes_per_second, std::memory_order_relaxed);
+	if (bytes_per_second == 0) {
+		byte_tokens_ = 0.0;
+	}
+}
+
+void Throttle::set_max_iops(uint32_t max_iops) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	refill_locked(std::chrono::steady_clock::now());
+	max_iops_.store(max_iops, std::memory_order_relaxed);
+	if (max_iops == 0) {
+		op_tokens_ = 0.0;
+	}
+}
+
+// Buckets hold at most one second of credit, but may go into debt: a read is charged
+// up front and the caller waits until the debt has been paid off at the current rate.
+void Throttle::refill_locked(std::chrono::steady_clock::time_point now) {
+	double seconds = std::chrono::duration<double>(now - last_refill_).count();
+	last_refill_ = now;
+
+	double byte_rate = static_cast<double>(bytes_per_second_.load(std::memory_order_relaxed));
+	if (byte_rate > 0.0) {
+		byte_tokens_ = std::min(byte_tokens_ + byte_rate * seconds, byte_rate);
+	} else {
+		byte_tokens_ = 0.0;
+	}
+
+	double op_rate = static_cast<double>(max_iops_.load(std::memory_order_relaxed));
+	if (op_rate > 0.0) {
+		op_tokens_ = std::min(op_tokens_ + op_rate * seconds, op_rate);
+	} else {
+		op_tokens_ = 0.0;
+	}
+}
+
+void Throttle::acquire(uint64_t bytes) {
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		refill_locked(std::chrono::steady_clock::now());
+		if (bytes_per_second_.load(std::memory_order_relaxed) > 0) {
+			byte_tokens_ -= static_cast<double>(bytes);
+		}
+		if (max_iops_.load(std::memory_order_relaxed) > 0) {
+			op_tokens_ -= 1.0;
+		}
+	}
+
+	for (;;) {
+		double wait_seconds = 0.0;
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			refill_locked(std::chrono::steady_clock::now());
+			double byte_rate = static_cast<double>(bytes_per_second_.load(std::memory_order_relaxed));
+			double op_rate = static_cast<double>(max_iops_.load(std::memory_order_relaxed));
+			if (byte_tokens_ < 0.0 && byte_rate > 0.0) {
+				wait_seconds = std::max(wait_seconds, -byte_tokens_ / byte_rate);
+			}
+			if (op_tokens_ < 0.0 && op_rate > 0.0) {
+				wait_seconds = std::max(wait_seconds, -op_tokens_ / op_rate);
+			}
+		}
+		if (wait_seconds <= 0.0) {
+			return;
+		}
+		auto wait = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(wait_seconds));
+		std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(wait, kMaxThrottleSleep));
+	}
+}
+
+void Throttle::refund(uint64_t bytes) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	refill_locked(std::chrono::steady_clock::now());
+	double byte_rate = static_cast<double>(bytes_per_second_.load(std::memory_order_relaxed));
+	if (byte_rate > 0.0) {
+		byte_tokens_ = std::min(byte_tokens_ + static_cast<double>(bytes), byte_rate);
+	}
+}
+
+size_t Throttle::read_size(size_t capacity) const {
+	uint64_t byte_rate = bytes_per_second();
+	if (byte_rate == 0) {
+		return capacity;
+	}
+	uint64_t reads_per_second = 10;
+	uint32_t op_rate = max_iops();
+	if (op_rate > 0 && op_rate < reads_per_second) {
+		reads_per_second = op_rate;
+	}
+	uint64_t size = std::max<uint64_t>(byte_rate / reads_per_second, kMinThrottledRead);
+	return static_cast<size_t>(std::min<uint64_t>(size, capacity));
+}
+
+bool set_thread_background_mode(bool enable) {
+	if (enable == t_in_background) {
+		return true;
+	}
+	if (!SetThreadPriority(GetCurrentThread(), enable ? THREAD_MODE_BACKGROUND_BEGIN : THREAD_MODE_BACKGROUND_END)) {
+		return false;
+	}
+	t_in_background = enable;
+	return true;
+}
+
+bool compute_sha256_streamed_throttled(const fs::path &file_path,
+	Sha256Digest &out_digest,
+	uint64_t &out_size_bytes,
+	double &out_elapsed_seconds,
+	std::string &out_error,
+	Throttle *throttle,
+	std::atomic<bool> *cancel_flag,
+	ProgressCallback progress_cb,
+	void *user_data) {
+	if (!throttle) {
+		return compute_sha256_streamed_with_progress(file_path, out_digest, out_size_bytes, out_elapsed_seconds, out_error, cancel_flag, progress_cb, user_data);
+	}
+	ThrottledSource<Win32FileSource> source(throttle);
+	if (!cancel_flag && !progress_cb) {
+		NullProgress progress;
+		return hash_file<CngSha256>(source, file_path, out_digest, out_size_bytes, out_elapsed_seconds, out_error, progress);
+	}
+	CallbackProgress progress;
+	progress.cancel_flag = cancel_flag;
+	progress.callback = progress_cb;
+	progress.user_data = user_data;
+	return hash_file<CngSha256>(source, file_path, out_digest, out_size_bytes, out_elapsed_seconds, out_error, progress);
+}
+
+}
@@ -0,0 +1,138 @@
+// throttle.hpp - I/O bandwidth, IOPS and priority throttling for background hashing
+#pragma once
+
+#include "hash.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <utility>
+
+namespace hashcore {
+
+// Shared token bucket limiting bytes/second and reads/second across every job that uses it.
+// All limits may be changed from any thread while jobs are running; 0 means unlimited.
+class Throttle {
+public:
+	explicit Throttle(uint64_t bytes_per_second = 0, uint32_t max_iops = 0, bool background = false);
+	Throttle(const Throttle &) = delete;
+	Throttle &operator=(const Throttle &) = delete;
+
+	void set_bytes_per_second(uint64_t bytes_per_second);
+	void set_max_iops(uint32_t max_iops);
+	// Run reading threads in background mode (low I/O, memory and CPU priority).
+	void set_background(bool background) { background_.store(background, std::memory_order_relaxed); }
+
+	uint64_t bytes_per_second() const { return bytes_per_second_.load(std::memory_order_relaxed); }
+	uint32_t max_iops() const { return max_iops_.load(std::memory_order_relaxed); }
+	bool background() const { return background_.load(std::memory_order_relaxed); }
+
+	// Charge one read of `bytes` and block until the buckets are back in credit.
+	void acquire(uint64_t bytes);
+	// Return credit for bytes charged by acquire() but not actually read (short read / EOF).
+	void refund(uint64_t bytes);
+	// Largest read that keeps I/O smooth at the current limits: about a tenth of a second of
+	// the byte rate (fewer, larger reads if max_iops is lower), never below kMinThrottledRead.
+	size_t read_size(size_t capacity) const;
+
+private:
+	void refill_locked(std::chrono::steady_clock::time_point now);
+
+	std::atomic<uint64_t> bytes_per_second_;
+	std::atomic<uint32_t> max_iops_;
+	std::atomic<bool> background_;
+
+	std::mutex mutex_;
+	double byte_tokens_ = 0.0;
+	double op_tokens_ = 0.0;
+	std::chrono::steady_clock::time_point last_refill_;
+};
+
+// Enter or leave background processing mode for the calling thread. The current state is
+// tracked per thread, so repeated calls are free. Returns false if the OS rejected the change.
+bool set_thread_background_mode(bool enable);
+
+constexpr size_t kMinThrottledRead = 64 * 1024;
+
+// Source policy decorator that charges every read against a Throttle and keeps the
+// reading thread's background mode in sync with the throttle's current setting. The mode is
+// switched inside read(), so it follows whichever thread issues the I/O (e.g. a ChunkPipeline
+// producer rather than the thread that opened the source), and ends on that thread at EOF or
+// on error.
+template <class Source>
+class ThrottledSource {
+public:
+	template <class... Args>
+	explicit ThrottledSource(Throttle *throttle, Args &&...args) : inner_(std::forward<Args>(args)...), throttle_(throttle) {}
+	ThrottledSource(const ThrottledSource &) = delete;
+	ThrottledSource &operator=(const ThrottledSource &) = delete;
+	// Covers a reader that stopped before EOF on the destroying thread; a no-op elsewhere.
+	~ThrottledSource() {
+		if (throttle_) {
+			set_thread_background_mode(false);
+		}
+	}
+
+	bool open(const fs::path &file_path, std::string &out_error) {
+		if (!inner_.open(file_path, out_error)) {
+			return false;
+		}
+		remaining_ = inner_.size();
+		return true;
+	}
+
+	uint64_t size() const { return inner_.size(); }
+
+	bool read(unsigned char *buffer, size_t capacity, size_t &out_read, std::string &out_error) {
+		if (!throttle_) {
+			return inner_.read(buffer, capacity, out_read, out_error);
+		}
+		set_thread_background_mode(throttle_->background());
+		// Charge before issuing the read, and keep reads small at low rates, so the device
+		// sees evenly spaced requests instead of full-buffer bursts followed by long sleeps.
+		// Only the bytes the file is expected to still hold are charged, so the final EOF
+		// probe does not sleep; anything a growing file returns beyond that is charged after.
+		size_t request = throttle_->read_size(capacity);
+		size_t charged = static_cast<size_t>(std::min<uint64_t>(request, remaining_));
+		if (charged > 0) {
+			throttle_->acquire(charged);
+		}
+		bool ok = inner_.read(buffer, request, out_read, out_error);
+		if (!ok) {
+			out_read = 0;
+		}
+		if (out_read < charged) {
+			throttle_->refund(charged - out_read);
+		} else if (out_read > charged) {
+			throttle_->acquire(out_read - charged);
+		}
+		remaining_ -= std::min<uint64_t>(remaining_, out_read);
+		if (!ok || out_read == 0) {
+			set_thread_background_mode(false);
+		}
+		return ok;
+	}
+
+private:
+	Source inner_;
+	Throttle *throttle_ = nullptr;
+	uint64_t remaining_ = 0;
+};
+
+// Hash a file through a shared Throttle; throttle may be null for no limit.
+// Every read is charged against the throttle's byte-rate and IOPS buckets, and the reading
+// thread follows the throttle's background-priority setting. Limits may be changed while running.
+bool compute_sha256_streamed_throttled(const fs::path &file_path,
+	Sha256Digest &out_digest,
+	uint64_t &out_size_bytes,
+	double &out_elapsed_seconds,
+	std::string &out_error,
+	Throttle *throttle,
+	std::atomic<bool> *cancel_flag,
+	ProgressCallback progress_cb,
+	void *user_data);
+
+}
@@ -0,0 +1,177 @@
+#ifndef _WIN32_WINNT
+#define _WIN32_WINNT 0x0601  // processor groups and NUMA allocation APIs
+#endif
+#include "topology.hpp"
+
+#include <windows.h>
+#include <algorithm>
+#include <cstring>
+
+namespace hashcore {
+
+namespace {
+
+struct CoreInfo {
+	GROUP_AFFINITY affinity;
+	uint32_t node;
+};
+
+// Set bit positions of a processor mask, lowest first.
+std::vector<uint8_t> mask_bits(KAFFINITY mask) {
+	std::vector<uint8_t> bits;
+	for (uint8_t bit = 0; bit < sizeof(KAFFINITY) * 8; ++bit) {
+		if (mask & (static_cast<KAFFINITY>(1) << bit)) {
+			bits.push_back(bit);
+		}
+	}
+	return bits;
+}
+
+}
+
+uint32_t CpuTopology::node_index(uint32_t node) const {
+	auto it = std::lower_bound(node_numbers.begin(), node_numbers.end(), node);
+	if (it == node_numbers.end() || *it != node) {
+		return kAnyNode;
+	}
+	return static_cast<uint32_t>(it - node_numbers.begin());
+}
+
+bool query_cpu_topology(CpuTopology &out_topology, std::string &out_error) {
+	out_topology = CpuTopology{};
+	DWORD length = 0;
+	GetLogicalProcessorInformationEx(RelationAll, nullptr, &length);
+	if (GetLastError() != ERROR_INSUFFICIENT_BUFFER) {
+		out_error = "GetLogicalProcessorInformationEx failed";
+		return false;
+	}
+	std::vector<unsigned char> buffer(length);
+	if (!GetLogicalProcessorInformationEx(RelationAll, reinterpret_cast<PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX>(buffer.data()), &length)) {
+		out_error = "GetLogicalProcessorInformationEx failed";
+		return false;
+	}
+
+	std::vector<std::pair<uint32_t, GROUP_AFFINITY>> nodes;
+	std::vector<GROUP_AFFINITY> cores;
+	for (DWORD offset = 0; offset < length;) {
+		const auto *info = reinterpret_cast<const SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX *>(buffer.data() + offset);
+		if (info->Relationship == RelationNumaNode) {
+			nodes.emplace_back(info->NumaNode.NodeNumber, info->NumaNode.GroupMask);
+		} else if (info->Relationship == RelationProcessorCore) {
+			cores.push_back(info->Processor.GroupMask[0]);
+		}
+		offset += info->Size;
+	}
+	if (cores.empty()) {
+		out_error = "No processor cores reported";
+		return false;
+	}
+
+	for (const auto &node : nodes) {
+		out_topology.node_numbers.push_back(node.first);
+	}
+	if (out_topology.node_numbers.empty()) {
+		out_topology.node_numbers.push_back(0);
+	}
+	std::sort(out_topology.node_numbers.begin(), out_topology.node_numbers.end());
+	out_topology.node_numbers.erase(std::unique(out_topology.node_numbers.begin(), out_topology.node_numbers.end()), out_topology.node_numbers.end());
+	out_topology.core_count = static_cast<uint32_t>(cores.size());
+
+	// Bucket cores by node so placement can alternate between sockets.
+	std::vector<std::vector<CoreInfo>> by_node(out_topology.node_numbers.size());
+	for (const GROUP_AFFINITY &core : cores) {
+		uint32_t node = out_topology.node_numbers.front();
+		for (const auto &candidate : nodes) {
+			if (candidate.second.Group == core.Group && (candidate.second.Mask & core.Mask)) {
+				node = candidate.first;
+				break;
+			}
+		}
+		by_node[out_topology.node_index(node)].push_back(CoreInfo{core, node});
+	}
+
+	size_t max_cores = 0;
+	for (const auto &list : by_node) {
+		max_cores = std::max(max_cores, list.size());
+	}
+	// Pass 0 takes the first logical processor of every core; later passes add SMT siblings.
+	for (size_t pass = 0;; ++pass) {
+		bool any = false;
+		for (size_t k = 0; k < max_cores; ++k) {
+			for (size_t n = 0; n < by_node.size(); ++n) {
+				if (k >= by_node[n].size()) {
+					continue;
+				}
+				const CoreInfo &core = by_node[n][k];
+				std::vector<uint8_t> bits = mask_bits(core.affinity.Mask);
+				if (pass >= bits.size()) {
+					continue;
+				}
+				CpuSlot slot;
+				slot.group = core.affinity.Group;
+				slot.processor = bits[pass];
+				slot.node = core.node;
+				slot.node_index = static_cast<uint32_t>(n);
+				slot.smt_sibling = pass > 0;
+				out_topology.slots.push_back(slot);
+				any = true;
+			}
+		}
+		if (!any) {
+			break;
+		}
+	}
+	return true;
+}
+
+bool pin_current_thread(const CpuSlot &slot) {
+	GROUP_AFFINITY affinity{};
+	affinity.Group = slot.group;
+	affinity.Mask = static_cast<KAFFINITY>(1) << slot.processor;
+	return SetThreadGroupAffinity(GetCurrentThread(), &affinity, nullptr) != FALSE;
+}
+
+bool query_volume_serial(const fs::path &path, uint64_t &out_volume, std::string &out_error) {
+	wchar_t volume_root[MAX_PATH + 1] = {};
+	if (!GetVolumePathNameW(path.wstring().c_str(), volume_root, MAX_PATH + 1)) {
+		out_error = "Failed to resolve volume";
+		return false;
+	}
+	DWORD serial = 0;
+	if (!GetVolumeInformationW(volume_root, nullptr, 0, &serial, nullptr, nullptr, nullptr, 0)) {
+		out_error = "Failed to query volume information";
+		return false;
+	}
+	out_volume = serial;
+	return true;
+}
+
+bool NodeLocalBuffer::allocate(size_t size, uint32_t node, std::string &out_error) {
+	release();
+	void *memory = nullptr;
+	if (node != kAnyNode) {
+		memory = VirtualAllocExNuma(GetCurrentProcess(), nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE, node);
+	}
+	if (!memory) {
+		memory = VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+	}
+	if (!memory) {
+		out_error = "Failed to allocate read buffer";
+		return false;
+	}
+	// Fault every page in now, from this thread, rather than during the first read.
+	std::memset(memory, 0, size);
+	data_ = static_cast<unsigned char *>(memory);
+	size_ = size;
+	return true;
+}
+
+void NodeLocalBuffer::release() {
+	if (data_) {
+		VirtualFree(data_, 0, MEM_RELEASE);
+		data_ = nullptr;
+		size_ = 0;
+	}
+}
+
+}
@@ -0,0 +1,65 @@
+// topology.hpp - NUMA node and core discovery, worker pinning, node-local buffers
+#pragma once
+
+#include "hash.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace hashcore {
+
+constexpr uint32_t kAnyNode = 0xFFFFFFFF;
+
+// One logical processor a worker can be pinned to.
+struct CpuSlot {
+	uint16_t group = 0;
+	uint8_t processor = 0;     // bit index within the processor group
+	uint32_t node = 0;         // OS NUMA node number
+	uint32_t node_index = 0;   // dense index into CpuTopology::node_numbers
+	bool smt_sibling = false;  // shares a core (and its L1/L2) with an earlier slot
+};
+
+struct CpuTopology {
+	std::vector<uint32_t> node_numbers;  // OS node numbers, ascending
+	uint32_t core_count = 0;
+	// Placement order: one logical processor per physical core, round-robin across nodes,
+	// followed by the remaining SMT siblings in the same order. Worker i takes slots[i % size].
+	std::vector<CpuSlot> slots;
+
+	// Dense index of an OS node number, or kAnyNode if the node has no processors.
+	uint32_t node_index(uint32_t node) const;
+};
+
+bool query_cpu_topology(CpuTopology &out_topology, std::string &out_error);
+
+// Restrict the calling thread to one logical processor.
+bool pin_current_thread(const CpuSlot &slot);
+
+// Serial number of the volume holding `path`; matches FileIdentity::volume.
+bool query_volume_serial(const fs::path &path, uint64_t &out_volume, std::string &out_error);
+
+// Read buffer committed on a chosen NUMA node. Pages are touched by the allocating thread,
+// so a pinned worker that allocates its own buffer gets local memory even when the node
+// hint is unavailable (first-touch placement).
+class NodeLocalBuffer {
+public:
+	NodeLocalBuffer() = default;
+	NodeLocalBuffer(const NodeLocalBuffer &) = delete;
+	NodeLocalBuffer &operator=(const NodeLocalBuffer &) = delete;
+	~NodeLocalBuffer() { release(); }
+
+	// node = kAnyNode leaves placement to first touch.
+	bool allocate(size_t size, uint32_t node, std::string &out_error);
+	void release();
+
+	unsigned char *data() const { return data_; }
+	size_t size() const { return size_; }
+
+private:
+	unsigned char *data_ = nullptr;
+	size_t size_ = 0;
+};
+
+}
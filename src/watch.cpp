@@ -0,0 +1,324 @@
+#ifndef _WIN32_WINNT
+#define _WIN32_WINNT 0x0600  // GetFileInformationByHandleEx
+#endif
+#include "watch.hpp"
+
+#include <windows.h>
+#include <algorithm>
+#include <deque>
+#include <future>
+#include <unordered_map>
+#include <vector>
+
+namespace hashcore {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Upper bound on one wait, so stop requests and finished hashes are noticed promptly.
+constexpr std::chrono::milliseconds kMaxWait{50};
+// ReadDirectoryChangesW rejects buffers over 64 KB for network shares.
+constexpr DWORD kNotifyBufferSize = 64 * 1024;
+
+uint64_t system_time_ticks() {
+	FILETIME now{};
+	GetSystemTimeAsFileTime(&now);
+	return (static_cast<uint64_t>(now.dwHighDateTime) << 32) | now.dwLowDateTime;
+}
+
+// ChangeTime, unlike the last-write time, is also updated when a file is renamed or moved
+// into the tree, so it catches write-to-temp-then-rename arrivals whose events were lost.
+bool changed_since(const fs::path &path, uint64_t threshold_ticks) {
+	HANDLE handle = CreateFileW(path.wstring().c_str(), FILE_READ_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, nullptr);
+	if (handle == INVALID_HANDLE_VALUE) {
+		return true;  // let the hash attempt report whatever is wrong with it
+	}
+	FILE_BASIC_INFO info{};
+	BOOL ok = GetFileInformationByHandleEx(handle, FileBasicInfo, &info, sizeof(info));
+	CloseHandle(handle);
+	if (!ok) {
+		return true;
+	}
+	uint64_t changed = static_cast<uint64_t>(std::max(info.ChangeTime.QuadPart, info.LastWriteTime.QuadPart));
+	return changed >= threshold_ticks;
+}
+
+class DirectoryWatcher {
+public:
+	DirectoryWatcher(const fs::path &root, const WatchOptions &options, WatchCallback on_record, void *user_data)
+		: root_(root), options_(options), service_(options.service), on_record_(on_record), user_data_(user_data) {
+		unsigned workers = options.service.worker_count ? options.service.worker_count : std::max(1u, std::thread::hardware_concurrency());
+		max_in_flight_ = options.max_in_flight ? options.max_in_flight : workers * 2;
+	}
+
+	bool run(std::atomic<bool> &stop_flag, std::string &out_error) {
+		HANDLE directory = CreateFileW(root_.wstring().c_str(), FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr);
+		if (directory == INVALID_HANDLE_VALUE) {
+			out_error = "Failed to open directory for watching";
+			return false;
+		}
+		HANDLE event = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+		if (!event) {
+			CloseHandle(directory);
+			out_error = "CreateEventW failed";
+			return false;
+		}
+
+		std::vector<DWORD> buffer(kNotifyBufferSize / sizeof(DWORD));
+		OVERLAPPED overlapped{};
+		overlapped.hEvent = event;
+		uint64_t last_delivery = system_time_ticks();
+
+		bool ok = arm(directory, buffer, overlapped);
+		if (!ok) {
+			out_error = "ReadDirectoryChangesW failed";
+		}
+		while (ok && !stop_flag.load(std::memory_order_relaxed)) {
+			DWORD wait_ms = static_cast<DWORD>(std::chrono::duration_cast<std::chrono::milliseconds>(time_until_next_deadline(Clock::now())).count());
+			if (WaitForSingleObject(event, wait_ms) == WAIT_OBJECT_0) {
+				DWORD bytes = 0;
+				bool overflow = false;
+				if (!GetOverlappedResult(directory, &overlapped, &bytes, FALSE)) {
+					if (GetLastError() != ERROR_NOTIFY_ENUM_DIR) {
+						out_error = "ReadDirectoryChangesW failed";
+						ok = false;
+						break;
+					}
+					overflow = true;
+				}
+				if (overflow || bytes == 0) {
+					rescan_since(last_delivery);
+				} else {
+					handle_notifications(reinterpret_cast<const unsigned char *>(buffer.data()), bytes);
+				}
+				last_delivery = system_time_ticks();
+				ResetEvent(event);
+				if (!arm(directory, buffer, overlapped)) {
+					out_error = "ReadDirectoryChangesW failed";
+					ok = false;
+					break;
+				}
+			}
+			Clock::time_point now = Clock::now();
+			publish_finished(now);
+			dispatch_due(now);
+		}
+
+		CancelIoEx(directory, &overlapped);
+		DWORD ignored = 0;
+		GetOverlappedResult(directory, &overlapped, &ignored, TRUE);
+		CloseHandle(event);
+		CloseHandle(directory);
+		return ok;
+	}
+
+private:
+	struct PendingFile {
+		Clock::time_point deadline;
+		Clock::time_point last_event;
+		// Set by ADDED / RENAMED_NEW_NAME. A directory arriving that way brings contents that
+		// raised no events of their own; MODIFIED on a directory only means an entry changed.
+		bool arrived = false;
+	};
+	struct InFlight {
+		std::wstring relative;
+		std::shared_future<FileHashResult> future;
+		Clock::time_point last_event;
+		bool discard = false;
+	};
+
+	bool arm(HANDLE directory, std::vector<DWORD> &buffer, OVERLAPPED &overlapped) {
+		DWORD filter = FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_SIZE;
+		return ReadDirectoryChangesW(directory, buffer.data(), static_cast<DWORD>(buffer.size() * sizeof(DWORD)), options_.recursive ? TRUE : FALSE, filter, nullptr, &overlapped, nullptr) != FALSE;
+	}
+
+	void handle_notifications(const unsigned char *data, DWORD length) {
+		Clock::time_point now = Clock::now();
+		DWORD offset = 0;
+		for (;;) {
+			if (offset + sizeof(FILE_NOTIFY_INFORMATION) > length) {
+				break;
+			}
+			const FILE_NOTIFY_INFORMATION *info = reinterpret_cast<const FILE_NOTIFY_INFORMATION *>(data + offset);
+			std::wstring relative(info->FileName, info->FileNameLength / sizeof(WCHAR));
+			switch (info->Action) {
+			case FILE_ACTION_ADDED:
+			case FILE_ACTION_RENAMED_NEW_NAME:
+				schedule(relative, now, true);
+				break;
+			case FILE_ACTION_MODIFIED:
+				schedule(relative, now, false);
+				break;
+			case FILE_ACTION_REMOVED:
+			case FILE_ACTION_RENAMED_OLD_NAME:
+				removed(relative, now);
+				break;
+			default:
+				break;
+			}
+			if (info->NextEntryOffset == 0) {
+				break;
+			}
+			offset += info->NextEntryOffset;
+		}
+	}
+
+	// Every new event pushes the deadline out again: bursts collapse into one hash.
+	void schedule(const std::wstring &relative, Clock::time_point now, bool arrived) {
+		PendingFile &pending = pending_[relative];
+		pending.last_event = now;
+		pending.deadline = now + options_.settle_delay;
+		pending.arrived = pending.arrived || arrived;
+	}
+
+	// Removal is reported immediately; a hash still in flight for the path is discarded.
+	void removed(const std::wstring &relative, Clock::time_point now) {
+		pending_.erase(relative);
+		for (InFlight &job : in_flight_) {
+			if (job.relative == relative) {
+				job.discard = true;
+			}
+		}
+		WatchRecord record;
+		record.path = fs::path(relative).generic_u8string();
+		record.removed = true;
+		record.success = true;
+		record.latency_seconds = std::chrono::duration<double>(Clock::now() - now).count();
+		on_record_(record, user_data_);
+	}
+
+	// Events were dropped: pick up anything written, renamed or moved in since the last
+	// delivered batch (FILETIME ticks), once.
+	void rescan_since(uint64_t since) {
+		Clock::time_point now = Clock::now();
+		uint64_t margin = static_cast<uint64_t>(options_.settle_delay.count()) * 10000;
+		uint64_t threshold = since > margin ? since - margin : 0;
+		std::error_code ec;
+		auto options = fs::directory_options::skip_permission_denied;
+		for (fs::recursive_directory_iterator it(root_, options, ec), end; !ec && it != end; it.increment(ec)) {
+			if (!options_.recursive) {
+				it.disable_recursion_pending();
+			}
+			std::error_code entry_ec;
+			if (!it->is_regular_file(entry_ec)) {
+				continue;
+			}
+			if (changed_since(it->path(), threshold)) {
+				schedule(it->path().lexically_relative(root_).wstring(), now, false);
+			}
+		}
+	}
+
+	Clock::duration time_until_next_deadline(Clock::time_point now) const {
+		Clock::duration wait = kMaxWait;
+		if (in_flight_.size() < max_in_flight_) {
+			for (const auto &entry : pending_) {
+				wait = std::min<Clock::duration>(wait, std::max<Clock::duration>(entry.second.deadline - now, Clock::duration::zero()));
+			}
+		}
+		return wait;
+	}
+
+	// A writer that still holds the file open blocks an open that refuses to share writing.
+	// Delete sharing is granted so the probe never makes a producer's rename or delete fail.
+	bool writer_still_open(const fs::path &path) const {
+		HANDLE handle = CreateFileW(path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (handle == INVALID_HANDLE_VALUE) {
+			return GetLastError() == ERROR_SHARING_VIOLATION;
+		}
+		CloseHandle(handle);
+		return false;
+	}
+
+	void dispatch_due(Clock::time_point now) {
+		std::vector<std::wstring> due;
+		for (const auto &entry : pending_) {
+			if (entry.second.deadline <= now) {
+				due.push_back(entry.first);
+			}
+		}
+		for (const std::wstring &relative : due) {
+			if (in_flight_.size() >= max_in_flight_) {
+				return;
+			}
+			fs::path full = root_ / relative;
+			std::error_code ec;
+			if (fs::is_directory(full, ec)) {
+				// A directory created or moved in whole produces one event; schedule what it
+				// contains. Other directory events are noise: its entries report themselves.
+				bool arrived = pending_[relative].arrived;
+				pending_.erase(relative);
+				if (arrived && options_.recursive) {
+					for (fs::recursive_directory_iterator it(full, fs::directory_options::skip_permission_denied, ec), end; !ec && it != end; it.increment(ec)) {
+						std::error_code entry_ec;
+						if (it->is_regular_file(entry_ec)) {
+							schedule(it->path().lexically_relative(root_).wstring(), now, false);
+						}
+					}
+				}
+				continue;
+			}
+			if (writer_still_open(full)) {
+				pending_[relative].deadline = now + options_.settle_delay;
+				continue;
+			}
+			InFlight job;
+			job.relative = relative;
+			job.last_event = pending_[relative].last_event;
+			job.future = service_.submit(full);
+			in_flight_.push_back(std::move(job));
+			pending_.erase(relative);
+		}
+	}
+
+	void publish_finished(Clock::time_point now) {
+		for (auto it = in_flight_.begin(); it != in_flight_.end();) {
+			if (it->future.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+				++it;
+				continue;
+			}
+			// Changed again while hashing: the newer pending entry will publish instead.
+			if (!it->discard && pending_.find(it->relative) == pending_.end()) {
+				const FileHashResult &result = it->future.get();
+				WatchRecord record;
+				record.path = fs::path(it->relative).generic_u8string();
+				record.success = result.success;
+				record.size_bytes = result.size_bytes;
+				record.digest = result.digest;
+				record.error = result.error;
+				record.latency_seconds = std::chrono::duration<double>(now - it->last_event).count();
+				on_record_(record, user_data_);
+			}
+			it = in_flight_.erase(it);
+		}
+	}
+
+	fs::path root_;
+	WatchOptions options_;
+	HashService service_;
+	WatchCallback on_record_;
+	void *user_data_;
+	size_t max_in_flight_ = 0;
+
+	std::unordered_map<std::wstring, PendingFile> pending_;
+	std::deque<InFlight> in_flight_;
+};
+
+}
+
+bool watch_directory(const fs::path &root,
+	const WatchOptions &options,
+	std::atomic<bool> &stop_flag,
+	WatchCallback on_record,
+	void *user_data,
+	std::string &out_error) {
+	if (!on_record) {
+		out_error = "No record callback";
+		return false;
+	}
+	DirectoryWatcher watcher(root, options, on_record, user_data);
+	return watcher.run(stop_flag, out_error);
+}
+
+}
@@ -0,0 +1,48 @@
+// watch.hpp - keep digests of a drop directory current as files settle
+#pragma once
+
+#include "hash.hpp"
+#include "hash_service.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace hashcore {
+
+struct WatchOptions {
+	bool recursive = true;
+	// A file is hashed once it has seen no change events for this long and no writer holds it open.
+	std::chrono::milliseconds settle_delay{250};
+	// Hash jobs allowed in flight at once (0 = twice the worker count); further settled files wait.
+	size_t max_in_flight = 0;
+	ServiceOptions service;  // worker pool size and optional throttle
+};
+
+struct WatchRecord {
+	std::string path;        // relative to the watched root, '/' separated, UTF-8
+	bool removed = false;    // deleted or renamed away; no digest
+	bool success = false;
+	uint64_t size_bytes = 0;
+	Sha256Digest digest{};
+	std::string error;
+	double latency_seconds = 0.0;  // last change event -> record published
+};
+
+// Called on the watching thread for every settled file and every removal.
+using WatchCallback = void(*)(const WatchRecord &record, void *user_data);
+
+// Watch `root` with ReadDirectoryChangesW until stop_flag becomes true. Only files named in
+// change notifications are hashed; there is no periodic rescan. If the OS change buffer
+// overflows, files written, renamed or moved in since the last delivered batch (by change
+// time, which a rename updates) are rescheduled once.
+// Returns false if the directory cannot be watched.
+bool watch_directory(const fs::path &root,
+	const WatchOptions &options,
+	std::atomic<bool> &stop_flag,
+	WatchCallback on_record,
+	void *user_data,
+	std::string &out_error);
+
+}
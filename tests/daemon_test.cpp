@@ -0,0 +1,274 @@
+// daemon_test.cpp - protocol round-trips, frame rejection and an in-process daemon exchange
+#include "daemon.hpp"
+#include "daemon_protocol.hpp"
+#include "hash.hpp"
+#include "throttle.hpp"
+
+#include <windows.h>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace hashcore;
+
+namespace {
+
+int g_failures = 0;
+
+void check(bool condition, const char *what) {
+	if (!condition) {
+		std::cerr << "FAIL: " << what << "\n";
+		++g_failures;
+	}
+}
+
+// Split an encoded frame back into header + payload.
+bool split_frame(const std::vector<unsigned char> &frame, FrameHeader &out_header, std::vector<unsigned char> &out_payload) {
+	std::string error;
+	if (frame.size() < kFrameHeaderSize || !decode_frame_header(frame.data(), out_header, error)) {
+		return false;
+	}
+	out_payload.assign(frame.begin() + kFrameHeaderSize, frame.end());
+	return out_payload.size() == out_header.payload_length;
+}
+
+Request round_trip(const Request &request, bool &out_ok) {
+	FrameHeader header;
+	std::vector<unsigned char> payload;
+	Request decoded;
+	std::string error;
+	out_ok = split_frame(encode_request(request), header, payload) && header.opcode == request.opcode && decode_request(header.opcode, payload, decoded, error);
+	return decoded;
+}
+
+void test_request_round_trip() {
+	bool ok = false;
+	Request hash;
+	hash.opcode = Opcode::Hash;
+	hash.paths = {u8"C:\\data\\\u00e9t\u00e9.iso"};
+	Request decoded = round_trip(hash, ok);
+	check(ok && decoded.paths == hash.paths, "Hash request round-trip");
+
+	Request verify;
+	verify.opcode = Opcode::Verify;
+	verify.paths = {"C:\\a.bin"};
+	for (size_t i = 0; i < verify.expected.bytes.size(); ++i) {
+		verify.expected.bytes[i] = static_cast<unsigned char>(i * 7);
+	}
+	decoded = round_trip(verify, ok);
+	check(ok && decoded.paths == verify.paths && decoded.expected.bytes == verify.expected.bytes, "Verify request round-trip");
+
+	Request batch;
+	batch.opcode = Opcode::Batch;
+	batch.paths = {"a", "", "c\\d"};
+	decoded = round_trip(batch, ok);
+	check(ok && decoded.paths == batch.paths, "Batch request round-trip");
+
+	Request shutdown;
+	shutdown.opcode = Opcode::Shutdown;
+	decoded = round_trip(shutdown, ok);
+	check(ok && decoded.paths.empty(), "Shutdown request round-trip");
+
+	Request limits;
+	limits.opcode = Opcode::SetThrottle;
+	limits.bytes_per_second = 123456789012ULL;
+	limits.max_iops = 250;
+	limits.background = true;
+	decoded = round_trip(limits, ok);
+	check(ok && decoded.bytes_per_second == limits.bytes_per_second && decoded.max_iops == limits.max_iops && decoded.background, "SetThrottle request round-trip");
+}
+
+void test_response_round_trip() {
+	Response response;
+	response.opcode = Opcode::Batch;
+	ResultRecord ok_record;
+	ok_record.flags = kResultFromCache | kResultCoalesced;
+	ok_record.size_bytes = 0x0123456789ABCDEFULL;
+	ok_record.digest.bytes.fill(0xAB);
+	ResultRecord error_record;
+	error_record.status = ResultStatus::Error;
+	error_record.message = "Failed to open file";
+	response.results = {ok_record, error_record};
+
+	FrameHeader header;
+	std::vector<unsigned char> payload;
+	Response decoded;
+	std::string error;
+	bool ok = split_frame(encode_response(response), header, payload) && decode_response(header.opcode, payload, decoded, error);
+	check(ok && decoded.opcode == Opcode::Batch && decoded.results.size() == 2, "Response round-trip");
+	if (ok && decoded.results.size() == 2) {
+		check(decoded.results[0].status == ResultStatus::Ok && decoded.results[0].flags == ok_record.flags && decoded.results[0].size_bytes == ok_record.size_bytes && decoded.results[0].digest.bytes == ok_record.digest.bytes, "Response record fields");
+		check(decoded.results[1].status == ResultStatus::Error && decoded.results[1].message == error_record.message, "Response error record");
+	}
+}
+
+void test_frame_rejection() {
+	Request batch;
+	batch.opcode = Opcode::Batch;
+	batch.paths = {"first", "second"};
+	std::vector<unsigned char> frame = encode_request(batch);
+	FrameHeader header;
+	std::vector<unsigned char> payload;
+	check(split_frame(frame, header, payload), "Valid frame accepted");
+	std::string error;
+	Request decoded;
+
+	// Every strict prefix of the payload is malformed, as is trailing garbage.
+	bool all_rejected = true;
+	for (size_t length = 0; length < payload.size(); ++length) {
+		std::vector<unsigned char> truncated(payload.begin(), payload.begin() + length);
+		all_rejected = all_rejected && !decode_request(Opcode::Batch, truncated, decoded, error);
+	}
+	check(all_rejected, "Truncated request payload rejected");
+	std::vector<unsigned char> padded = payload;
+	padded.push_back(0);
+	check(!decode_request(Opcode::Batch, padded, decoded, error), "Request with trailing bytes rejected");
+
+	Response response;
+	response.opcode = Opcode::Hash;
+	response.results.resize(1);
+	std::vector<unsigned char> response_frame = encode_response(response);
+	std::vector<unsigned char> response_payload(response_frame.begin() + kFrameHeaderSize, response_frame.end() - 1);
+	Response decoded_response;
+	check(!decode_response(Opcode::Hash, response_payload, decoded_response, error), "Truncated response payload rejected");
+
+	// A path count far beyond the payload must fail cleanly rather than allocate.
+	std::vector<unsigned char> huge_count = {0xFF, 0xFF, 0xFF, 0xFF};
+	check(!decode_request(Opcode::Batch, huge_count, decoded, error), "Oversized batch count rejected");
+
+	std::vector<unsigned char> oversized = frame;
+	uint32_t too_big = kMaxPayloadSize + 1;
+	std::memcpy(oversized.data() + 8, &too_big, sizeof(too_big));
+	check(!decode_frame_header(oversized.data(), header, error), "Oversized payload length rejected");
+
+	std::vector<unsigned char> bad_magic = frame;
+	bad_magic[0] ^= 0xFF;
+	check(!decode_frame_header(bad_magic.data(), header, error), "Bad magic rejected");
+
+	std::vector<unsigned char> bad_version = frame;
+	bad_version[4] = kProtocolVersion + 1;
+	check(!decode_frame_header(bad_version.data(), header, error), "Unknown version rejected");
+
+	std::vector<unsigned char> bad_opcode = frame;
+	bad_opcode[5] = 0;
+	check(!decode_frame_header(bad_opcode.data(), header, error), "Opcode 0 rejected");
+	bad_opcode[5] = 200;
+	check(!decode_frame_header(bad_opcode.data(), header, error), "Unknown opcode rejected");
+}
+
+bool write_file(const fs::path &path, size_t size) {
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	for (size_t i = 0; i < size; ++i) {
+		out.put(static_cast<char>((i * 131) ^ (i >> 8)));
+	}
+	return static_cast<bool>(out);
+}
+
+void test_daemon_exchange() {
+	std::error_code ec;
+	fs::path directory = fs::temp_directory_path(ec) / ("c-hash-test-" + std::to_string(GetCurrentProcessId()));
+	fs::create_directories(directory, ec);
+	fs::path file = directory / "data.bin";
+	check(write_file(file, 3 * 1024 * 1024 + 17), "Test file written");
+	Sha256Digest expected{};
+	uint64_t size_bytes = 0;
+	double elapsed = 0.0;
+	std::string error;
+	check(compute_sha256_streamed(file, expected, size_bytes, elapsed, error), "Reference digest computed");
+
+	// A --socket path naming an ordinary file must be refused, not deleted.
+	DaemonOptions misdirected;
+	misdirected.socket_path = directory / "data.bin";
+	std::string refused;
+	check(!run_daemon(misdirected, refused) && fs::exists(file, ec), "Regular file at socket path left alone");
+
+	DaemonOptions options;
+	options.socket_path = directory / "daemon.sock";
+	options.service.worker_count = 2;
+	Throttle throttle;  // unlimited until the batch below slows it down
+	options.service.throttle = &throttle;
+	bool daemon_ok = false;
+	std::string daemon_error;
+	std::thread daemon([&]() { daemon_ok = run_daemon(options, daemon_error); });
+
+	DaemonClient client;
+	bool connected = false;
+	for (int attempt = 0; attempt < 100 && !connected; ++attempt) {
+		connected = client.connect(options.socket_path, error);
+		if (!connected) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		}
+	}
+	check(connected, "Client connected to daemon");
+	if (connected) {
+		std::string path = file.u8string();
+		Response response;
+
+		Request hash;
+		hash.opcode = Opcode::Hash;
+		hash.paths = {path};
+		bool ok = client.call(hash, response, error) && response.results.size() == 1;
+		check(ok && response.results[0].status == ResultStatus::Ok && response.results[0].digest.bytes == expected.bytes && response.results[0].size_bytes == size_bytes, "Hash matches local digest");
+		ok = client.call(hash, response, error) && response.results.size() == 1;
+		check(ok && (response.results[0].flags & kResultFromCache), "Repeated hash served from cache");
+
+		Request verify;
+		verify.opcode = Opcode::Verify;
+		verify.paths = {path};
+		verify.expected = expected;
+		ok = client.call(verify, response, error) && response.results.size() == 1;
+		check(ok && response.results[0].status == ResultStatus::Ok, "Verify accepts matching digest");
+		verify.expected.bytes[0] ^= 1;
+		ok = client.call(verify, response, error) && response.results.size() == 1;
+		check(ok && response.results[0].status == ResultStatus::Mismatch, "Verify reports mismatch");
+
+		// Throttle to 64 KiB/s through the daemon so the first read of a fresh 128 KiB file
+		// takes about two seconds; the duplicate is submitted while it is still in flight.
+		Request limits;
+		limits.opcode = Opcode::SetThrottle;
+		limits.bytes_per_second = 64 * 1024;
+		ok = client.call(limits, response, error) && response.results.size() == 1;
+		check(ok && response.results[0].status == ResultStatus::Ok && throttle.bytes_per_second() == limits.bytes_per_second, "SetThrottle applied");
+		fs::path fresh = directory / "fresh.bin";
+		write_file(fresh, 128 * 1024);
+		Request batch;
+		batch.opcode = Opcode::Batch;
+		batch.paths = {fresh.u8string(), fresh.u8string(), (directory / "missing.bin").u8string()};
+		ok = client.call(batch, response, error) && response.results.size() == 3;
+		check(ok, "Batch returns one record per path");
+		if (ok) {
+			check(response.results[0].status == ResultStatus::Ok && !(response.results[0].flags & kResultCoalesced), "First batch entry hashed");
+			check(response.results[1].status == ResultStatus::Ok && (response.results[1].flags & kResultCoalesced) && response.results[1].digest.bytes == response.results[0].digest.bytes, "Duplicate batch entry coalesced");
+			check(response.results[2].status == ResultStatus::Error && !response.results[2].message.empty(), "Missing file reported as error");
+		}
+		limits.bytes_per_second = 0;
+		ok = client.call(limits, response, error) && response.results.size() == 1;
+		check(ok && throttle.bytes_per_second() == 0, "SetThrottle lifts the limit");
+
+		Request shutdown;
+		shutdown.opcode = Opcode::Shutdown;
+		check(client.call(shutdown, response, error), "Shutdown acknowledged");
+	}
+	daemon.join();
+	check(daemon_ok, "run_daemon returned true after Shutdown");
+	fs::remove_all(directory, ec);
+}
+
+}
+
+int main() {
+	test_request_round_trip();
+	test_response_round_trip();
+	test_frame_rejection();
+	test_daemon_exchange();
+	if (g_failures) {
+		std::cerr << g_failures << " check(s) failed\n";
+		return 1;
+	}
+	std::cout << "All daemon tests passed\n";
+	return 0;
+}
@@ -0,0 +1,254 @@
+// tar_stream_test.cpp - TarStreamHasher against handmade ustar, GNU and pax headers
+#include "tar_stream.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace hashcore;
+
+namespace {
+
+int g_failures = 0;
+
+void check(bool condition, const char *what) {
+	if (!condition) {
+		std::cerr << "FAIL: " << what << "\n";
+		++g_failures;
+	}
+}
+
+// Digest policy that records the member bytes it was given, so tests can compare data exactly.
+struct CollectDigest {
+	using result_type = std::string;
+	std::string bytes;
+
+	bool init(std::string &) {
+		bytes.clear();
+		return true;
+	}
+	bool update(const unsigned char *data, size_t length, std::string &) {
+		bytes.append(reinterpret_cast<const char *>(data), length);
+		return true;
+	}
+	bool finish(std::string &out_result, std::string &) {
+		out_result.swap(bytes);
+		bytes.clear();
+		return true;
+	}
+};
+
+using Hasher = TarStreamHasher<CollectDigest>;
+using Block = std::vector<unsigned char>;
+
+const char kPosixMagic[8] = {'u', 's', 't', 'a', 'r', '\0', '0', '0'};
+const char kGnuMagic[8] = {'u', 's', 't', 'a', 'r', ' ', ' ', '\0'};
+
+void put_octal(Block &header, size_t offset, size_t width, uint64_t value) {
+	std::string digits;
+	do {
+		digits.insert(digits.begin(), static_cast<char>('0' + (value & 7)));
+		value >>= 3;
+	} while (value);
+	digits.insert(0, width - 1 - digits.size(), '0');
+	std::memcpy(header.data() + offset, digits.data(), digits.size());
+}
+
+void seal(Block &header) {
+	std::memset(header.data() + 148, ' ', 8);
+	uint64_t checksum = 0;
+	for (unsigned char b : header) {
+		checksum += b;
+	}
+	char field[8];
+	std::snprintf(field, sizeof(field), "%06o", static_cast<unsigned>(checksum));
+	std::memcpy(header.data() + 148, field, 7);
+}
+
+Block make_header(const std::string &name, uint64_t size, char type, const char (&magic)[8], const std::string &prefix = "") {
+	Block header(512, 0);
+	std::memcpy(header.data(), name.data(), std::min<size_t>(name.size(), 100));
+	put_octal(header, 100, 8, 0644);
+	put_octal(header, 124, 12, size);
+	put_octal(header, 136, 12, 0);
+	header[156] = static_cast<unsigned char>(type);
+	std::memcpy(header.data() + 257, magic, 8);
+	std::memcpy(header.data() + 345, prefix.data(), std::min<size_t>(prefix.size(), 155));
+	seal(header);
+	return header;
+}
+
+void append(Block &archive, const Block &header, const std::string &data = "") {
+	archive.insert(archive.end(), header.begin(), header.end());
+	archive.insert(archive.end(), data.begin(), data.end());
+	archive.resize(archive.size() + (512 - data.size() % 512) % 512, 0);
+}
+
+void append_end(Block &archive) {
+	archive.resize(archive.size() + 1024, 0);
+}
+
+std::string pax_record(const std::string &key, const std::string &value) {
+	std::string body = " " + key + "=" + value + "\n";
+	size_t length = body.size() + 1;
+	while (std::to_string(length).size() + body.size() != length) {
+		++length;
+	}
+	return std::to_string(length) + body;
+}
+
+// Feed the archive in `slice`-byte pieces (0 = all at once).
+bool parse(const Block &archive, size_t slice, std::vector<Hasher::Member> &out_members, std::string &out_error) {
+	Hasher hasher;
+	if (!hasher.init(out_error)) {
+		return false;
+	}
+	size_t step = slice ? slice : archive.size();
+	for (size_t offset = 0; offset < archive.size(); offset += step) {
+		if (!hasher.feed(archive.data() + offset, std::min(step, archive.size() - offset), out_error)) {
+			return false;
+		}
+	}
+	if (!hasher.finish(out_error)) {
+		return false;
+	}
+	out_members = std::move(hasher.members());
+	return true;
+}
+
+void test_ustar_prefix_and_gnu_magic() {
+	Block archive;
+	append(archive, make_header("file.txt", 5, '0', kPosixMagic, "dir/sub"), "hello");
+	// Old GNU headers keep atime/ctime where ustar has its prefix; it must not leak into the name.
+	Block gnu = make_header("gnu.txt", 3, '0', kGnuMagic);
+	put_octal(gnu, 345, 12, 01234567);
+	put_octal(gnu, 357, 12, 07654321);
+	seal(gnu);
+	append(archive, gnu, "abc");
+	append(archive, make_header("empty", 0, '\0', kPosixMagic));
+	append(archive, make_header("dir/", 0, '5', kPosixMagic));
+	append_end(archive);
+
+	std::vector<Hasher::Member> members;
+	std::string error;
+	bool ok = parse(archive, 0, members, error);
+	check(ok && members.size() == 3, "ustar/GNU archive parsed, directory skipped");
+	if (ok && members.size() == 3) {
+		check(members[0].name == "dir/sub/file.txt" && members[0].digest == "hello", "ustar prefix joined to name");
+		check(members[1].name == "gnu.txt" && members[1].digest == "abc" && members[1].size_bytes == 3, "GNU magic ignores prefix field");
+		check(members[2].name == "empty" && members[2].size_bytes == 0 && members[2].digest.empty(), "Empty member recorded");
+	}
+}
+
+void test_gnu_long_name_and_pax() {
+	std::string long_name(180, 'n');
+	long_name += "/tail.bin";
+	std::string pax_name = "pax/\xc3\xa9t\xc3\xa9.txt";
+	std::string pax = pax_record("path", pax_name) + pax_record("size", "4") + pax_record("mtime", "1.5");
+
+	Block archive;
+	append(archive, make_header("././@LongLink", long_name.size() + 1, 'L', kGnuMagic), long_name + '\0');
+	append(archive, make_header("truncated-name", 2, '0', kGnuMagic), "xy");
+	append(archive, make_header("PaxHeaders/x", pax.size(), 'x', kPosixMagic), pax);
+	// The pax size overrides the (deliberately wrong) header size.
+	append(archive, make_header("short", 1, '0', kPosixMagic), "data");
+	append(archive, make_header("global", pax_record("comment", "skip me").size(), 'g', kPosixMagic), pax_record("comment", "skip me"));
+	append(archive, make_header("after", 1, '0', kPosixMagic), "z");
+	append_end(archive);
+
+	std::vector<Hasher::Member> members;
+	std::string error;
+	bool ok = parse(archive, 0, members, error);
+	check(ok && members.size() == 3, "Long-name/pax archive parsed");
+	if (ok && members.size() == 3) {
+		check(members[0].name == long_name && members[0].digest == "xy", "GNU long name applied");
+		check(members[1].name == pax_name && members[1].size_bytes == 4 && members[1].digest == "data", "pax path and size applied");
+		check(members[2].name == "after" && members[2].digest == "z", "pax global header skipped, state reset");
+	}
+
+	// Same result no matter how the stream is sliced.
+	for (size_t slice : {1u, 7u, 511u, 513u}) {
+		std::vector<Hasher::Member> sliced;
+		bool same = parse(archive, slice, sliced, error) && sliced.size() == members.size();
+		for (size_t i = 0; same && i < sliced.size(); ++i) {
+			same = sliced[i].name == members[i].name && sliced[i].digest == members[i].digest;
+		}
+		check(same, "Sliced input gives identical members");
+	}
+}
+
+void test_base256_size() {
+	std::string data(700, 'q');
+	Block header = make_header("big", 0, '0', kGnuMagic);
+	std::memset(header.data() + 124, 0, 12);
+	header[124] = 0x80;
+	header[134] = static_cast<unsigned char>(data.size() >> 8);
+	header[135] = static_cast<unsigned char>(data.size() & 0xFF);
+	seal(header);
+	Block archive;
+	append(archive, header, data);
+	append_end(archive);
+
+	std::vector<Hasher::Member> members;
+	std::string error;
+	bool ok = parse(archive, 0, members, error);
+	check(ok && members.size() == 1 && members[0].size_bytes == data.size() && members[0].digest == data, "Base-256 size parsed");
+}
+
+void test_rejections() {
+	std::vector<Hasher::Member> members;
+	std::string error;
+
+	Block bad_checksum;
+	append(bad_checksum, make_header("file", 1, '0', kPosixMagic), "a");
+	bad_checksum[0] ^= 1;
+	append_end(bad_checksum);
+	check(!parse(bad_checksum, 0, members, error) && error == "Invalid tar header checksum", "Bad checksum rejected");
+
+	Block bad_size = make_header("file", 1, '0', kPosixMagic);
+	std::memcpy(bad_size.data() + 124, "12345678x01", 11);
+	seal(bad_size);
+	Block archive;
+	append(archive, bad_size);
+	check(!parse(archive, 0, members, error) && error == "Invalid tar member size", "Non-octal size rejected");
+
+	Block base256_overflow = make_header("file", 0, '0', kGnuMagic);
+	std::memset(base256_overflow.data() + 124, 0xFF, 12);
+	base256_overflow[124] = 0x80;
+	seal(base256_overflow);
+	archive.clear();
+	append(archive, base256_overflow);
+	check(!parse(archive, 0, members, error), "Base-256 size above 64 bits rejected");
+
+	archive.clear();
+	append(archive, make_header("././@LongLink", Hasher::kMaxMetadataSize + 1, 'L', kGnuMagic));
+	check(!parse(archive, 0, members, error) && error == "Oversized tar metadata entry", "Oversized long name rejected");
+
+	archive.clear();
+	std::string broken_pax = "99 path=x\n";
+	append(archive, make_header("PaxHeaders/x", broken_pax.size(), 'x', kPosixMagic), broken_pax);
+	check(!parse(archive, 0, members, error) && error == "Invalid pax header", "Bad pax record length rejected");
+
+	archive.clear();
+	append(archive, make_header("file", 10, '0', kPosixMagic), "0123456789");
+	archive.resize(512 + 4);
+	check(!parse(archive, 0, members, error) && error == "Truncated tar archive", "Truncated member data rejected");
+}
+
+}
+
+int main() {
+	test_ustar_prefix_and_gnu_magic();
+	test_gnu_long_name_and_pax();
+	test_base256_size();
+	test_rejections();
+	if (g_failures) {
+		std::cerr << g_failures << " check(s) failed\n";
+		return 1;
+	}
+	std::cout << "All tar stream tests passed\n";
+	return 0;
+}